@@ -0,0 +1,1031 @@
+#include "mod_http.h"
+#include "mod_json.h"
+#include "mod_arena.h"
+#include "mod_inflate.h"
+#include "mod_http_client.h"
+
+#include <osapi.h>
+#include <mem.h>
+#include <time.h>
+#include <zlib.h>
+
+#define BENCH_DEFAULT_DATA_FILE				"data/directions_route.json"
+#define BENCH_JSON_PATH_DURATION			"routes[0].legs[*].duration_in_traffic.value"
+#define BENCH_JSON_TAG_STEPS				"\"steps\""
+#define BENCH_JSON_TAG_VALUE				"\"value\""
+#define BENCH_MIN_DURATION_NS				200000000LL
+#define BENCH_MIN_ITERATIONS				3
+// Free heap on target while response is received: idle free heap reported by status endpoint
+// minus TLS handshake buffer held by open connection (history window is sized to it as by HTTP client)
+#define BENCH_TARGET_FREE_HEAP				(31208 - TLS_HANDSHAKE_BUFFER_SIZE)
+#define BENCH_URL							"https://maps.googleapis.com/maps/api/directions/json?origin=51.564418%2C-0.062658&destination=51.519986%2C-0.082895&departure_time=now&key=KEY"
+
+// response sizes (approximate body size in bytes) - recorded route is scaled by repeating its steps
+static const size_t BODY_SIZES[] = { 0, 30 * 1024, 60 * 1024 };
+// chunk sizes used for chunked transfer encoding (cycled)
+static const size_t CHUNK_SIZES[] = { 8192, 1357, 4096 };
+
+#define FRAMING_CONTENT_LENGTH				0
+#define FRAMING_CHUNKED						1
+
+#define SEGMENTS_SINGLE						0
+#define SEGMENTS_MSS_1460					1
+#define SEGMENTS_MSS_536					2
+#define SEGMENTS_RANDOM						3
+
+static const char* FRAMING_NAMES[] = { "length", "chunked" };
+static const char* SEGMENTS_NAMES[] = { "single", "mss1460", "mss536", "random" };
+
+// ******************************** COUNTING ALLOCATOR ********************************
+
+struct alloc_header
+{
+	size_t size;
+	size_t reserved;
+};
+
+struct alloc_stats
+{
+	size_t count;
+	size_t current;
+	size_t peak;
+};
+
+static struct alloc_stats alloc_stats;
+
+void* bench_malloc(size_t size)
+{
+	struct alloc_header* header = (struct alloc_header*)malloc(sizeof(struct alloc_header) + size);
+	if (!header)
+	{
+		return NULL;
+	}
+	header->size = size;
+	++alloc_stats.count;
+	alloc_stats.current += size;
+	if (alloc_stats.current > alloc_stats.peak)
+	{
+		alloc_stats.peak = alloc_stats.current;
+	}
+	return header + 1;
+}
+
+void* bench_zalloc(size_t size)
+{
+	void* ptr = bench_malloc(size);
+	if (ptr)
+	{
+		os_bzero(ptr, size);
+	}
+	return ptr;
+}
+
+void bench_free(void* ptr)
+{
+	if (ptr)
+	{
+		struct alloc_header* header = ((struct alloc_header*)ptr) - 1;
+		alloc_stats.current -= header->size;
+		free(header);
+	}
+}
+
+void* bench_realloc(void* ptr, size_t size)
+{
+	void* result = bench_malloc(size);
+	if (result && ptr)
+	{
+		struct alloc_header* header = ((struct alloc_header*)ptr) - 1;
+		os_memcpy(result, ptr, header->size < size ? header->size : size);
+		bench_free(ptr);
+	}
+	return result;
+}
+
+// ******************************** TEST DATA ********************************
+
+struct response
+{
+	char* data;
+	size_t len;
+	const char* body;
+	size_t body_len;
+	uint8 framing;
+	bool is_gzip;
+};
+
+static char* load_file(const char* path, size_t* len)
+{
+	FILE* file = fopen(path, "rb");
+	if (!file)
+	{
+		return NULL;
+	}
+	fseek(file, 0, SEEK_END);
+	long int file_sz = ftell(file);
+	fseek(file, 0, SEEK_SET);
+	char* data = (char*)malloc(file_sz + 1);
+	*len = fread(data, 1, file_sz, file);
+	data[*len] = 0;
+	fclose(file);
+	return data;
+}
+
+// Finds matching closing bracket (JSON strings are skipped)
+static const char* find_closing_bracket(const char* open)
+{
+	int depth = 0;
+	bool in_string = false;
+	const char* p;
+	for (p = open; *p; ++p)
+	{
+		if (in_string)
+		{
+			if (*p == '\\')
+			{
+				++p;
+			}
+			else if (*p == '"')
+			{
+				in_string = false;
+			}
+		}
+		else if (*p == '"')
+		{
+			in_string = true;
+		}
+		else if (*p == '[' || *p == '{')
+		{
+			++depth;
+		}
+		else if ((*p == ']' || *p == '}') && --depth == 0)
+		{
+			return p;
+		}
+	}
+	return NULL;
+}
+
+// Scales recorded route body up to requested size by repeating content of its "steps" array
+static char* scale_body(const char* json, size_t target_len, size_t* len)
+{
+	size_t json_len = os_strlen(json);
+	const char* steps = os_strstr(json, BENCH_JSON_TAG_STEPS);
+	const char* steps_begin = steps ? os_strchr(steps, '[') : NULL;
+	const char* steps_end = steps_begin ? find_closing_bracket(steps_begin) : NULL;
+	if (!steps_end || target_len <= json_len)
+	{
+		*len = json_len;
+		return strdup(json);
+	}
+	const char* content = steps_begin + 1;
+	size_t content_len = steps_end - content;
+	size_t repeats = (target_len - json_len) / (content_len + 1) + 1;
+	char* body = (char*)malloc(json_len + repeats * (content_len + 1) + 1);
+	char* target = body;
+	os_memcpy(target, json, steps_end - json);
+	target += steps_end - json;
+	size_t i;
+	for (i = 0; i < repeats; ++i)
+	{
+		*target++ = ',';
+		os_memcpy(target, content, content_len);
+		target += content_len;
+	}
+	os_strcpy(target, steps_end);
+	*len = os_strlen(body);
+	return body;
+}
+
+// Compresses body the same way as server does (gzip member, default level and 32 KB window)
+static char* gzip_body(const char* body, size_t body_len, size_t* len)
+{
+	z_stream zs;
+	os_bzero(&zs, sizeof(zs));
+	if (deflateInit2(&zs, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 16 + MAX_WBITS, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+	{
+		return NULL;
+	}
+	size_t capacity = deflateBound(&zs, body_len);
+	char* result = (char*)malloc(capacity);
+	zs.next_in = (Bytef*)body;
+	zs.avail_in = body_len;
+	zs.next_out = (Bytef*)result;
+	zs.avail_out = capacity;
+	deflate(&zs, Z_FINISH);
+	*len = zs.total_out;
+	deflateEnd(&zs);
+	return result;
+}
+
+static void build_response(struct response* response, const char* body, size_t body_len, uint8 framing, bool is_gzip)
+{
+	char* target = (char*)malloc(body_len + body_len / 64 + 1024);
+	response->data = target;
+	response->body = body;
+	response->body_len = body_len;
+	response->framing = framing;
+	response->is_gzip = is_gzip;
+	target += os_sprintf(target, "HTTP/1.1 200 OK\r\n"
+			"Content-Type: application/json; charset=UTF-8\r\n"
+			"Date: Sun, 18 Sep 2022 10:00:00 GMT\r\n"
+			"Cache-Control: no-cache, must-revalidate\r\n"
+			"Server: mafe\r\n"
+			"X-XSS-Protection: 0\r\n"
+			"X-Frame-Options: SAMEORIGIN\r\n"
+			"Server-Timing: gfet4t7; dur=125\r\n"
+			"Alt-Svc: h3=\":443\"; ma=2592000,h3-29=\":443\"; ma=2592000\r\n"
+			"Accept-Ranges: none\r\n"
+			"Vary: Accept-Language,Accept-Encoding\r\n");
+	if (is_gzip)
+	{
+		target += os_sprintf(target, "Content-Encoding: gzip\r\n");
+	}
+	if (framing == FRAMING_CHUNKED)
+	{
+		target += os_sprintf(target, "Transfer-Encoding: chunked\r\n\r\n");
+		size_t idx = 0;
+		size_t chunk_idx = 0;
+		while (idx < body_len)
+		{
+			size_t chunk_sz = CHUNK_SIZES[chunk_idx++ % (sizeof(CHUNK_SIZES) / sizeof(CHUNK_SIZES[0]))];
+			if (chunk_sz > body_len - idx)
+			{
+				chunk_sz = body_len - idx;
+			}
+			target += os_sprintf(target, "%zx\r\n", chunk_sz);
+			os_memcpy(target, &body[idx], chunk_sz);
+			target += chunk_sz;
+			target += os_sprintf(target, "\r\n");
+			idx += chunk_sz;
+		}
+		target += os_sprintf(target, "0\r\n\r\n");
+	}
+	else
+	{
+		target += os_sprintf(target, "Content-Length: %zu\r\n\r\n", body_len);
+		os_memcpy(target, body, body_len);
+		target += body_len;
+		*target = 0;
+	}
+	response->len = target - response->data;
+}
+
+// Splits response into TCP segments according to pattern, returns number of segments
+static size_t build_segments(size_t* segments, size_t max_segments, size_t len, uint8 pattern)
+{
+	size_t count = 0;
+	size_t idx = 0;
+	uint32 seed = 12345;
+	while (idx < len && count < max_segments)
+	{
+		size_t seg_sz = len;
+		if (pattern == SEGMENTS_MSS_1460)
+		{
+			seg_sz = 1460;
+		}
+		else if (pattern == SEGMENTS_MSS_536)
+		{
+			seg_sz = 536;
+		}
+		else if (pattern == SEGMENTS_RANDOM)
+		{
+			seed = seed * 1103515245 + 12345;
+			seg_sz = 1 + (seed >> 16) % 1460;
+		}
+		if (seg_sz > len - idx)
+		{
+			seg_sz = len - idx;
+		}
+		segments[count++] = seg_sz;
+		idx += seg_sz;
+	}
+	return count;
+}
+
+// ******************************** MEASUREMENT ********************************
+
+struct bench_result
+{
+	double ns_per_call;
+	double mallocs_per_call;
+	size_t peak_heap;
+	bool valid;
+};
+
+typedef bool (*bench_function)(const struct response* response, const size_t* segments, size_t segments_count);
+
+static long long now_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (long long)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static struct bench_result measure(bench_function function, const struct response* response, const size_t* segments, size_t segments_count)
+{
+	struct bench_result result = { 0 };
+	size_t iterations = 0;
+	size_t mallocs = 0;
+	long long elapsed = 0;
+	result.valid = true;
+	while (elapsed < BENCH_MIN_DURATION_NS || iterations < BENCH_MIN_ITERATIONS)
+	{
+		os_bzero(&alloc_stats, sizeof(alloc_stats));
+		long long start = now_ns();
+		result.valid &= function(response, segments, segments_count);
+		elapsed += now_ns() - start;
+		mallocs += alloc_stats.count;
+		if (alloc_stats.peak > result.peak_heap)
+		{
+			result.peak_heap = alloc_stats.peak;
+		}
+		if (alloc_stats.current != 0)
+		{
+			// leaked memory is reported as failure
+			result.valid = false;
+		}
+		++iterations;
+	}
+	result.ns_per_call = (double)elapsed / iterations;
+	result.mallocs_per_call = (double)mallocs / iterations;
+	return result;
+}
+
+static void report(const char* name, const struct response* response, const char* segments_name, size_t segments_count, const struct bench_result* result)
+{
+	os_printf("%-22s %8zu %-8s %-8s %5zu %12.2f %10.1f %12.1f %10zu %s\n",
+			name,
+			response->len,
+			FRAMING_NAMES[response->framing],
+			segments_name,
+			segments_count,
+			result->ns_per_call / response->len,
+			result->ns_per_call / 1000,
+			result->mallocs_per_call,
+			result->peak_heap,
+			result->valid ? "" : "FAILED");
+}
+
+// ******************************** LEGACY BODY EXTRACTION ********************************
+
+// String-scanning extraction firmware used before the resumable parser (whole response buffered) - kept as baseline
+
+#define HTTP_HEADERS_BUFFER_SIZE			700
+
+static void parse_http_headers(const char* input_http_response, char* output_headers)
+{
+	output_headers[0] = 0;
+	char* pdelim = os_strstr(input_http_response, HTTP_HEADERS_DELIM);
+	if (pdelim)
+	{
+		size_t sz_headers_block = pdelim + os_strlen(HTTP_HEADERS_NL) - input_http_response;
+		os_memcpy(output_headers, input_http_response, sz_headers_block);
+		output_headers[sz_headers_block] = 0;
+	}
+}
+
+static void parse_http_header(const char* headers, const char* header_name, char* output_header_value)
+{
+	output_header_value[0] = 0;
+	size_t mark = arena_mark();
+	char* search_pattern = (char*)arena_alloc(HTTP_HEADER_BUFFER_SIZE);
+	if (!search_pattern)
+	{
+		return;
+	}
+	os_sprintf(search_pattern, "%s%s: ", HTTP_HEADERS_NL, header_name);
+	char* phead = strcasestr(headers, search_pattern);
+	if (phead)
+	{
+		char* phead_val = phead + os_strlen(search_pattern);
+		char* phead_end = os_strstr(phead_val, HTTP_HEADERS_NL);
+		if (phead_end)
+		{
+			os_memcpy(output_header_value, phead_val, phead_end - phead_val);
+			output_header_value[phead_end - phead_val] = 0;
+		}
+	}
+	arena_release(mark);
+}
+
+static bool is_end_of_content(const char* input_content)
+{
+	bool result = false;
+	size_t mark = arena_mark();
+	char* headers = (char*)arena_alloc(HTTP_HEADERS_BUFFER_SIZE);
+	char* header_value = (char*)arena_alloc(HTTP_HEADER_BUFFER_SIZE);
+	if (!headers || !header_value)
+	{
+		arena_release(mark);
+		return false;
+	}
+	parse_http_headers(input_content, headers);
+	if (os_strlen(headers) > 0)
+	{
+		parse_http_header(headers, HTTP_HEADERS_TRANSFER_ENCODING, header_value);
+		const char* raw_body = &input_content[os_strlen(headers) + os_strlen(HTTP_HEADERS_NL)];
+		if (os_strlen(header_value) > 0)
+		{
+			char* block_start;
+			const char* block_end = raw_body;
+			long int block_sz = strtol(raw_body, &block_start, 16);
+			if (block_sz > 0 && os_strstr(block_start, HTTP_HEADERS_NL) == block_start)
+			{
+				bool overrun_content = false;
+				while (block_sz > 0 && !overrun_content)
+				{
+					block_start += os_strlen(HTTP_HEADERS_NL);
+					block_end = block_start + block_sz;
+					overrun_content = ((block_end - raw_body) + os_strlen(HTTP_HEADERS_NL) > os_strlen(raw_body)) || os_strstr(block_end, HTTP_HEADERS_NL) != block_end;
+					if (!overrun_content)
+					{
+						block_sz = strtol(block_end + os_strlen(HTTP_HEADERS_NL), &block_start, 16);
+					}
+				}
+				result = (block_sz == 0);
+			}
+		}
+		else
+		{
+			parse_http_header(headers, HTTP_HEADERS_CONTENT_LENGTH, header_value);
+			if (os_strlen(header_value) > 0)
+			{
+				long int content_sz = strtol(header_value, NULL, 10);
+				if (content_sz > 0)
+				{
+					result = ((size_t)content_sz <= os_strlen(raw_body));
+				}
+				else
+				{
+					// Error case: Invalid Content-Length HTTP header value
+					result = true;
+				}
+			}
+			else
+			{
+				// Error case: Unable to identify content size
+				result = true;
+			}
+		}
+	}
+	arena_release(mark);
+	return result;
+}
+
+static int parse_http_body(const char* input_http_response, char* output_body)
+{
+	size_t mark = arena_mark();
+	char* headers = (char*)arena_alloc(HTTP_HEADERS_BUFFER_SIZE);
+	output_body[0] = 0;
+	if (!headers)
+	{
+		return HTTP_PARSE_ERROR_HEADERS;
+	}
+	parse_http_headers(input_http_response, headers);
+	if (os_strlen(headers) > 0)
+	{
+		char header_value[HTTP_HEADER_BUFFER_SIZE];
+		parse_http_header(headers, HTTP_HEADERS_TRANSFER_ENCODING, header_value);
+		const char* raw_body = &input_http_response[os_strlen(headers) + os_strlen(HTTP_HEADERS_NL)];
+		if (os_strlen(header_value) > 0)
+		{
+			char* block_start;
+			char* block_end;
+			size_t out_idx = 0;
+			long int block_sz = strtol(raw_body, &block_start, 16);
+			while (block_sz > 0)
+			{
+				block_start += os_strlen(HTTP_HEADERS_NL);
+				block_end = block_start + block_sz;
+				if ((size_t)(block_end - raw_body) > os_strlen(raw_body))
+				{
+					arena_release(mark);
+					return HTTP_PARSE_ERROR_BLOCK_LENGTH;
+				}
+				os_memcpy(&output_body[out_idx], block_start, block_sz);
+				out_idx += block_sz;
+				block_sz = strtol(block_end + os_strlen(HTTP_HEADERS_NL), &block_start, 16);
+			}
+			output_body[out_idx] = 0;
+			arena_release(mark);
+			return HTTP_PARSE_OK;
+		}
+		else
+		{
+			parse_http_header(headers, HTTP_HEADERS_CONTENT_LENGTH, header_value);
+			if (os_strlen(header_value) > 0)
+			{
+				long int content_sz = strtol(header_value, NULL, 10);
+				if (content_sz > 0 && (size_t)content_sz <= os_strlen(raw_body))
+				{
+					os_memcpy(output_body, raw_body, content_sz);
+					output_body[content_sz] = 0;
+					arena_release(mark);
+					return HTTP_PARSE_OK;
+				}
+			}
+			arena_release(mark);
+			return HTTP_PARSE_ERROR_CONTENT_LENGTH;
+		}
+	}
+	arena_release(mark);
+	return HTTP_PARSE_ERROR_HEADERS;
+}
+
+// ******************************** BENCHMARKED PATHS ********************************
+
+// Baseline receive path: whole response re-allocated and re-scanned on every TCP segment
+static bool bench_receive_rescan(const struct response* response, const size_t* segments, size_t segments_count)
+{
+	char* content = NULL;
+	size_t receive_idx = 0;
+	size_t i;
+	bool completed_at_last = false;
+	for (i = 0; i < segments_count; ++i)
+	{
+		char* local_content = (char*)os_malloc(receive_idx + segments[i] + 1);
+		if (receive_idx > 0)
+		{
+			os_memcpy(local_content, content, receive_idx);
+			os_free(content);
+		}
+		os_memcpy(&local_content[receive_idx], &response->data[receive_idx], segments[i]);
+		content = local_content;
+		receive_idx += segments[i];
+		content[receive_idx] = 0;
+		bool completed = is_end_of_content(content);
+		if (completed)
+		{
+			completed_at_last = (i == segments_count - 1);
+			break;
+		}
+	}
+	os_free(content);
+	return completed_at_last;
+}
+
+struct extract_state
+{
+	struct json_stream json;
+	sint32 duration;
+};
+
+static void on_bench_json_value(void* arg, const struct json_stream* stream, uint8 type, const char* value, size_t len)
+{
+	(void)len;
+	struct extract_state* state = (struct extract_state*)arg;
+	if (type == JSON_VALUE_NUMBER && json_stream_match(stream, BENCH_JSON_PATH_DURATION, NULL))
+	{
+		state->duration += strtol(value, NULL, 10);
+	}
+}
+
+static void on_bench_http_body(void* arg, const char* data, size_t len)
+{
+	struct extract_state* state = (struct extract_state*)arg;
+	json_stream_feed(&state->json, data, len);
+}
+
+static sint32 expected_duration = -1;
+
+// Extracts route time from a complete JSON body
+static sint32 find_expected_duration(const char* body, size_t body_len)
+{
+	struct extract_state state;
+	json_stream_init(&state.json, on_bench_json_value, &state);
+	state.duration = 0;
+	json_stream_feed(&state.json, body, body_len);
+	return state.duration;
+}
+
+// Incremental receive path: each segment parsed once, JSON value extracted while streaming
+static bool bench_receive_incremental(const struct response* response, const size_t* segments, size_t segments_count)
+{
+	struct http_response_parser parser;
+	struct extract_state state;
+	size_t idx = 0;
+	size_t i;
+	http_parser_init(&parser, on_bench_http_body, &state);
+	json_stream_init(&state.json, on_bench_json_value, &state);
+	state.duration = 0;
+	for (i = 0; i < segments_count; ++i)
+	{
+		if (http_parser_is_complete(&parser))
+		{
+			return false;
+		}
+		http_parser_feed(&parser, &response->data[idx], segments[i]);
+		idx += segments[i];
+	}
+	return http_parser_is_complete(&parser) && parser.error == HTTP_PARSE_OK && state.duration == expected_duration;
+}
+
+struct gzip_extract_state
+{
+	struct inflate_stream inflater;
+	struct extract_state extract;
+};
+
+static uint8 gzip_window_bits = INFLATE_WINDOW_BITS_MAX;
+
+static void on_bench_gzip_body(void* arg, const char* data, size_t len)
+{
+	struct gzip_extract_state* state = (struct gzip_extract_state*)arg;
+	inflate_feed(&state->inflater, data, len);
+}
+
+// Compressed receive path: each segment parsed once, inflated into history window and streamed to JSON extractor
+static bool bench_receive_gzip(const struct response* response, const size_t* segments, size_t segments_count)
+{
+	static struct gzip_extract_state state;
+	struct http_response_parser parser;
+	size_t idx = 0;
+	size_t i;
+	http_parser_init(&parser, on_bench_gzip_body, &state);
+	json_stream_init(&state.extract.json, on_bench_json_value, &state.extract);
+	state.extract.duration = 0;
+	if (!inflate_init(&state.inflater, gzip_window_bits, on_bench_http_body, &state.extract))
+	{
+		return false;
+	}
+	for (i = 0; i < segments_count; ++i)
+	{
+		http_parser_feed(&parser, &response->data[idx], segments[i]);
+		idx += segments[i];
+	}
+	inflate_release(&state.inflater);
+	return http_parser_is_complete(&parser) &&
+			parser.is_gzip &&
+			inflate_is_complete(&state.inflater) &&
+			state.extract.duration == expected_duration;
+}
+
+// Route fields extracted by JSON field matching scenarios
+struct route_fields
+{
+	sint32 duration_in_traffic;
+	sint32 duration;
+	sint32 distance;
+	char summary[JSON_STREAM_TOKEN_SIZE];
+	char status[16];
+};
+
+#define BENCH_FIELDS_COUNT					5
+
+JSON_PATH_DECLARE(BENCH_PATH_DURATION_IN_TRAFFIC, JSON_KEY("routes"), JSON_INDEX(0), JSON_KEY("legs"), JSON_ANY_INDEX,
+		JSON_KEY("duration_in_traffic"), JSON_KEY("value"));
+JSON_PATH_DECLARE(BENCH_PATH_DURATION, JSON_KEY("routes"), JSON_INDEX(0), JSON_KEY("legs"), JSON_ANY_INDEX,
+		JSON_KEY("duration"), JSON_KEY("value"));
+JSON_PATH_DECLARE(BENCH_PATH_DISTANCE, JSON_KEY("routes"), JSON_INDEX(0), JSON_KEY("legs"), JSON_ANY_INDEX,
+		JSON_KEY("distance"), JSON_KEY("value"));
+JSON_PATH_DECLARE(BENCH_PATH_SUMMARY, JSON_KEY("routes"), JSON_INDEX(0), JSON_KEY("summary"));
+JSON_PATH_DECLARE(BENCH_PATH_STATUS, JSON_KEY("status"));
+
+static const struct json_field BENCH_FIELDS[BENCH_FIELDS_COUNT] =
+{
+		JSON_FIELD(BENCH_PATH_DURATION_IN_TRAFFIC, JSON_FIELD_NUMBER_SUM, struct route_fields, duration_in_traffic),
+		JSON_FIELD(BENCH_PATH_DURATION, JSON_FIELD_NUMBER_SUM, struct route_fields, duration),
+		JSON_FIELD(BENCH_PATH_DISTANCE, JSON_FIELD_NUMBER_SUM, struct route_fields, distance),
+		JSON_FIELD(BENCH_PATH_SUMMARY, JSON_FIELD_STRING, struct route_fields, summary),
+		JSON_FIELD(BENCH_PATH_STATUS, JSON_FIELD_STRING, struct route_fields, status)
+};
+
+// Same fields as path strings for json_stream_match (string storage is the same as in field table)
+static const char* BENCH_FIELD_PATHS[BENCH_FIELDS_COUNT] =
+{
+		"routes[0].legs[*].duration_in_traffic.value",
+		"routes[0].legs[*].duration.value",
+		"routes[0].legs[*].distance.value",
+		"routes[0].summary",
+		"status"
+};
+
+// Fields extracted from recorded response by path string matching - reference result of other scenarios
+static struct route_fields expected_fields;
+
+static bool is_fields_matching(const struct route_fields* fields)
+{
+	return fields->duration_in_traffic == expected_fields.duration_in_traffic &&
+			fields->duration == expected_fields.duration &&
+			fields->distance == expected_fields.distance &&
+			os_strcmp(fields->summary, expected_fields.summary) == 0 &&
+			os_strcmp(fields->status, expected_fields.status) == 0;
+}
+
+// Baseline key search: each field is searched by its key over the whole body (key text inside string values matches as well,
+// only the first occurrence is taken), nested numeric values are taken from the following "value" key
+static bool bench_json_strstr_value(const char* body, const char* tag, char* output, size_t size)
+{
+	const char* value = os_strstr(body, tag);
+	if (!value)
+	{
+		return false;
+	}
+	value += os_strlen(tag);
+	if (size == 0)
+	{
+		value = os_strstr(value, BENCH_JSON_TAG_VALUE);
+		if (!value)
+		{
+			return false;
+		}
+		value += sizeof(BENCH_JSON_TAG_VALUE) - 1;
+	}
+	while (*value == ' ' || *value == ':' || *value == '"')
+	{
+		++value;
+	}
+	if (size == 0)
+	{
+		*(sint32*)output = strtol(value, NULL, 10);
+		return true;
+	}
+	size_t len = 0;
+	while (value[len] && value[len] != '"' && len < size - 1)
+	{
+		++len;
+	}
+	os_memcpy(output, value, len);
+	output[len] = 0;
+	return true;
+}
+
+static bool bench_json_strstr(const struct response* response, const size_t* segments, size_t segments_count)
+{
+	(void)segments;
+	(void)segments_count;
+	struct route_fields fields;
+	os_bzero(&fields, sizeof(fields));
+	bool is_found = bench_json_strstr_value(response->body, "\"duration_in_traffic\"", (char*)&fields.duration_in_traffic, 0);
+	is_found &= bench_json_strstr_value(response->body, "\"duration\"", (char*)&fields.duration, 0);
+	is_found &= bench_json_strstr_value(response->body, "\"distance\"", (char*)&fields.distance, 0);
+	is_found &= bench_json_strstr_value(response->body, "\"summary\"", fields.summary, sizeof(fields.summary));
+	is_found &= bench_json_strstr_value(response->body, "\"status\"", fields.status, sizeof(fields.status));
+	return is_found && is_fields_matching(&fields);
+}
+
+static void on_bench_json_paths_value(void* arg, const struct json_stream* stream, uint8 type, const char* value, size_t len)
+{
+	struct route_fields* fields = (struct route_fields*)arg;
+	uint8 i;
+	for (i = 0; i < BENCH_FIELDS_COUNT; ++i)
+	{
+		const struct json_field* field = &BENCH_FIELDS[i];
+		if (!json_stream_match(stream, BENCH_FIELD_PATHS[i], NULL))
+		{
+			continue;
+		}
+		if (field->kind == JSON_FIELD_STRING && type == JSON_VALUE_STRING)
+		{
+			char* target = (char*)fields + field->offset;
+			size_t copy_len = len < field->size ? len : (size_t)field->size - 1;
+			os_memcpy(target, value, copy_len);
+			target[copy_len] = 0;
+		}
+		else if (field->kind == JSON_FIELD_NUMBER_SUM && type == JSON_VALUE_NUMBER)
+		{
+			*(sint32*)((char*)fields + field->offset) += strtol(value, NULL, 10);
+		}
+		return;
+	}
+}
+
+// Path string matching: every value is compared against each path string
+static bool bench_json_match_paths(const struct response* response, const size_t* segments, size_t segments_count)
+{
+	(void)segments;
+	(void)segments_count;
+	struct json_stream json;
+	struct route_fields fields;
+	os_bzero(&fields, sizeof(fields));
+	json_stream_init(&json, on_bench_json_paths_value, &fields);
+	return json_stream_feed(&json, response->body, response->body_len) && is_fields_matching(&fields);
+}
+
+// Field table: matching state is advanced on keys / array elements, values are stored into result structure
+static bool bench_json_field_table(const struct response* response, const size_t* segments, size_t segments_count)
+{
+	(void)segments;
+	(void)segments_count;
+	struct json_stream json;
+	struct route_fields fields;
+	os_bzero(&fields, sizeof(fields));
+	json_stream_init(&json, NULL, NULL);
+	json_stream_set_fields(&json, BENCH_FIELDS, BENCH_FIELDS_COUNT, &fields);
+	return json_stream_feed(&json, response->body, response->body_len) &&
+			json.fields_found == (1UL << BENCH_FIELDS_COUNT) - 1 &&
+			is_fields_matching(&fields);
+}
+
+// Longest back reference of compressed body (defines minimal history window)
+static uint16 find_max_distance(const char* data, size_t len)
+{
+	struct inflate_stream inflater;
+	inflate_init(&inflater, INFLATE_WINDOW_BITS_MAX, NULL, NULL);
+	inflate_feed(&inflater, data, len);
+	inflate_release(&inflater);
+	return inflate_is_complete(&inflater) ? inflater.max_distance : 0;
+}
+
+// Inflates compressed body with given window, returns decoder error (reference beyond window is INFLATE_ERROR_DISTANCE)
+static int inflate_with_window(const char* data, size_t len, uint8 window_bits)
+{
+	struct inflate_stream inflater;
+	inflate_init(&inflater, window_bits, NULL, NULL);
+	inflate_feed(&inflater, data, len);
+	inflate_release(&inflater);
+	return inflater.error;
+}
+
+// Baseline body extraction: full body copied into a separate buffer
+static bool bench_parse_http_body(const struct response* response, const size_t* segments, size_t segments_count)
+{
+	(void)segments;
+	(void)segments_count;
+	char* body = (char*)os_zalloc(response->len);
+	int result = parse_http_body(response->data, body);
+	bool valid = (result == HTTP_PARSE_OK && os_strlen(body) == response->body_len);
+	os_free(body);
+	return valid;
+}
+
+// Zero-copy body view: de-chunks in place within the receive buffer.
+// Measured time includes restoring the response into the scratch receive buffer and comparing the result (plain memcpy / memcmp)
+static char* view_scratch = NULL;
+
+static bool bench_http_body_view(const struct response* response, const size_t* segments, size_t segments_count)
+{
+	(void)segments;
+	(void)segments_count;
+	char* body;
+	size_t body_len;
+	os_memcpy(view_scratch, response->data, response->len + 1);
+	int result = http_body_view(view_scratch, response->len, &body, &body_len);
+	return result == HTTP_PARSE_OK && body_len == response->body_len && os_memcmp(body, response->body, body_len) == 0;
+}
+
+static bool bench_parse_http_headers(const struct response* response, const size_t* segments, size_t segments_count)
+{
+	(void)segments;
+	(void)segments_count;
+	char headers[HTTP_HEADERS_BUFFER_SIZE];
+	char header_value[HTTP_HEADER_BUFFER_SIZE];
+	parse_http_headers(response->data, headers);
+	parse_http_header(headers, HTTP_HEADERS_TRANSFER_ENCODING, header_value);
+	return os_strlen(headers) > 0;
+}
+
+static bool bench_parse_http_header(const struct response* response, const size_t* segments, size_t segments_count)
+{
+	(void)segments;
+	(void)segments_count;
+	char header_value[HTTP_HEADER_BUFFER_SIZE];
+	parse_http_header(response->data, HTTP_HEADERS_CONTENT_LENGTH, header_value);
+	parse_http_header(response->data, HTTP_HEADERS_TRANSFER_ENCODING, header_value);
+	return true;
+}
+
+static bool bench_parse_url(const struct response* response, const size_t* segments, size_t segments_count)
+{
+	(void)response;
+	(void)segments;
+	(void)segments_count;
+	char hostname[HTTP_HEADER_BUFFER_SIZE];
+	char path[HTTP_URL_BUFFER_SIZE];
+	return parse_url(BENCH_URL, hostname, sizeof(hostname), path, sizeof(path)) == HTTP_URL_HTTPS;
+}
+
+int main(int argc, char** argv)
+{
+	const char* data_file = argc > 1 ? argv[1] : BENCH_DEFAULT_DATA_FILE;
+	size_t json_len;
+	char* json = load_file(data_file, &json_len);
+	if (!json)
+	{
+		os_printf("[ERROR] Unable to load recorded response: %s\n", data_file);
+		return 1;
+	}
+	bool all_valid = true;
+	expected_duration = find_expected_duration(json, json_len);
+	struct json_stream json_reference;
+	json_stream_init(&json_reference, on_bench_json_paths_value, &expected_fields);
+	json_stream_feed(&json_reference, json, json_len);
+	os_printf("[INFO] Recorded response: %s (%zu bytes), expected duration: %d\n", data_file, json_len, expected_duration);
+	os_printf("[INFO] Expected fields: duration in traffic %d, duration %d, distance %d, summary \"%s\", status \"%s\"\n\n",
+			expected_fields.duration_in_traffic,
+			expected_fields.duration,
+			expected_fields.distance,
+			expected_fields.summary,
+			expected_fields.status);
+	all_valid &= (expected_fields.duration_in_traffic == expected_duration && expected_fields.status[0]);
+	os_printf("%-22s %8s %-8s %-8s %5s %12s %10s %12s %10s\n", "scenario", "bytes", "framing", "segments", "count", "ns/byte", "us/call", "mallocs/call", "peak heap");
+
+	struct bench_result result;
+	size_t size_idx;
+	for (size_idx = 0; size_idx < sizeof(BODY_SIZES) / sizeof(BODY_SIZES[0]); ++size_idx)
+	{
+		size_t body_len;
+		char* body = scale_body(json, BODY_SIZES[size_idx], &body_len);
+		// JSON field extraction from the whole body: 5 fields of route (key search, path strings, field table)
+		struct response json_response = { body, body_len, body, body_len, FRAMING_CONTENT_LENGTH, false };
+		result = measure(bench_json_strstr, &json_response, NULL, 0);
+		report("json_strstr", &json_response, "-", 0, &result);
+		all_valid &= result.valid;
+		result = measure(bench_json_match_paths, &json_response, NULL, 0);
+		report("json_match_paths", &json_response, "-", 0, &result);
+		all_valid &= result.valid;
+		result = measure(bench_json_field_table, &json_response, NULL, 0);
+		report("json_field_table", &json_response, "-", 0, &result);
+		all_valid &= result.valid;
+		uint8 framing;
+		for (framing = FRAMING_CONTENT_LENGTH; framing <= FRAMING_CHUNKED; ++framing)
+		{
+			struct response response;
+			build_response(&response, body, body_len, framing, false);
+			size_t* segments = (size_t*)malloc(response.len * sizeof(size_t));
+			uint8 pattern;
+			for (pattern = SEGMENTS_SINGLE; pattern <= SEGMENTS_RANDOM; ++pattern)
+			{
+				size_t segments_count = build_segments(segments, response.len, response.len, pattern);
+				result = measure(bench_receive_rescan, &response, segments, segments_count);
+				report("receive_rescan", &response, SEGMENTS_NAMES[pattern], segments_count, &result);
+				all_valid &= result.valid;
+				result = measure(bench_receive_incremental, &response, segments, segments_count);
+				report("receive_incremental", &response, SEGMENTS_NAMES[pattern], segments_count, &result);
+				all_valid &= result.valid;
+			}
+			result = measure(bench_parse_http_body, &response, NULL, 0);
+			report("parse_http_body", &response, "-", 0, &result);
+			all_valid &= result.valid;
+			view_scratch = (char*)malloc(response.len + 1);
+			result = measure(bench_http_body_view, &response, NULL, 0);
+			report("http_body_view", &response, "-", 0, &result);
+			all_valid &= result.valid;
+			free(view_scratch);
+			result = measure(bench_parse_http_headers, &response, NULL, 0);
+			report("parse_http_headers", &response, "-", 0, &result);
+			all_valid &= result.valid;
+			result = measure(bench_parse_http_header, &response, NULL, 0);
+			report("parse_http_header", &response, "-", 0, &result);
+			all_valid &= result.valid;
+			free(segments);
+			free(response.data);
+		}
+		// Same body compressed with gzip: wire size and receive path cost with maximal history window and the one
+		// HTTP client picks on target (response referring beyond it has to be rejected, so identity encoding follows)
+		size_t gzip_len = 0;
+		char* gzip = gzip_body(body, body_len, &gzip_len);
+		uint16 max_distance = find_max_distance(gzip, gzip_len);
+		uint8 target_window_bits = inflate_fit_window_bits(BENCH_TARGET_FREE_HEAP - HTTP_CLIENT_GZIP_HEAP_RESERVE);
+		bool fits_target_window = (max_distance > 0 && target_window_bits > 0 && max_distance <= (1UL << target_window_bits));
+		os_printf("%-22s %8zu -> %zu bytes (%.1f%%), max back reference: %u bytes, target window %lu bytes (free heap %d): %s\n",
+				"gzip body",
+				body_len,
+				gzip_len,
+				100.0 * gzip_len / body_len,
+				max_distance,
+				target_window_bits ? 1UL << target_window_bits : 0,
+				BENCH_TARGET_FREE_HEAP,
+				fits_target_window ? "inflated" : "rejected (falls back to identity encoding)");
+		all_valid &= (max_distance > 0 && target_window_bits > 0);
+		all_valid &= (inflate_with_window(gzip, gzip_len, target_window_bits) == (fits_target_window ? INFLATE_OK : INFLATE_ERROR_DISTANCE));
+		for (framing = FRAMING_CONTENT_LENGTH; framing <= FRAMING_CHUNKED; ++framing)
+		{
+			struct response response;
+			build_response(&response, gzip, gzip_len, framing, true);
+			size_t* segments = (size_t*)malloc(response.len * sizeof(size_t));
+			uint8 pattern;
+			for (pattern = SEGMENTS_SINGLE; pattern <= SEGMENTS_RANDOM; ++pattern)
+			{
+				size_t segments_count = build_segments(segments, response.len, response.len, pattern);
+				gzip_window_bits = INFLATE_WINDOW_BITS_MAX;
+				result = measure(bench_receive_gzip, &response, segments, segments_count);
+				report("receive_gzip_32k", &response, SEGMENTS_NAMES[pattern], segments_count, &result);
+				all_valid &= result.valid;
+				if (fits_target_window)
+				{
+					gzip_window_bits = target_window_bits;
+					result = measure(bench_receive_gzip, &response, segments, segments_count);
+					report("receive_gzip_target", &response, SEGMENTS_NAMES[pattern], segments_count, &result);
+					all_valid &= result.valid;
+				}
+			}
+			free(segments);
+			free(response.data);
+		}
+		free(gzip);
+		free(body);
+	}
+	result = measure(bench_parse_url, NULL, NULL, 0);
+	os_printf("\n%-22s %12.2f ns/call %12.1f mallocs/call %10zu peak heap %s\n",
+			"parse_url",
+			result.ns_per_call,
+			result.mallocs_per_call,
+			result.peak_heap,
+			result.valid ? "" : "FAILED");
+	all_valid &= result.valid;
+	os_printf("%-22s %12zu of %d bytes\n", "arena high-water", arena_high_water(), ARENA_SIZE);
+	free(json);
+	return all_valid ? 0 : 1;
+}
@@ -0,0 +1,23 @@
+#ifndef BENCH_SHIM_C_TYPES_H_
+#define BENCH_SHIM_C_TYPES_H_
+
+// Host (Linux) replacement of ESP8266 SDK basic types
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+typedef uint8_t		uint8;
+typedef int8_t		sint8;
+typedef uint16_t	uint16;
+typedef int16_t		sint16;
+typedef uint32_t	uint32;
+typedef int32_t		sint32;
+typedef uint64_t	uint64;
+typedef int64_t		sint64;
+
+#define ICACHE_FLASH_ATTR
+#define ICACHE_RODATA_ATTR
+#define STORE_ATTR				__attribute__((aligned(4)))
+
+#endif /* BENCH_SHIM_C_TYPES_H_ */
@@ -0,0 +1,18 @@
+#ifndef BENCH_SHIM_MEM_H_
+#define BENCH_SHIM_MEM_H_
+
+// Host (Linux) replacement of ESP8266 SDK heap API - routed to counting allocator
+
+#include <stddef.h>
+
+void* bench_malloc(size_t size);
+void* bench_zalloc(size_t size);
+void* bench_realloc(void* ptr, size_t size);
+void bench_free(void* ptr);
+
+#define os_malloc				bench_malloc
+#define os_zalloc				bench_zalloc
+#define os_realloc				bench_realloc
+#define os_free					bench_free
+
+#endif /* BENCH_SHIM_MEM_H_ */
@@ -0,0 +1,29 @@
+#ifndef BENCH_SHIM_OSAPI_H_
+#define BENCH_SHIM_OSAPI_H_
+
+// Host (Linux) replacement of ESP8266 SDK string and print helpers
+
+#include <string.h>
+#include <strings.h>
+#include <stdlib.h>
+#include <stdio.h>
+
+#include "c_types.h"
+
+#define os_memcmp				memcmp
+#define os_memcpy				memcpy
+#define os_memmove				memmove
+#define os_memset				memset
+#define os_bzero(p, n)			memset((p), 0, (n))
+#define os_strcat				strcat
+#define os_strchr				strchr
+#define os_strcmp				strcmp
+#define os_strcpy				strcpy
+#define os_strlen				strlen
+#define os_strncmp				strncmp
+#define os_strncpy				strncpy
+#define os_strstr				strstr
+#define os_sprintf				sprintf
+#define os_printf				printf
+
+#endif /* BENCH_SHIM_OSAPI_H_ */
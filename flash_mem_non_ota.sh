@@ -2,6 +2,11 @@ PORT=/dev/serial/esp8266
 PYTHON=/usr/bin/python2.7
 ESP_TOOL=~/.local/bin/esptool.py
 FW_BIN_DIR=~/esp8266-dev-kits/esp-native-sdk/bin
+# optional runtime configuration image (tools/config_tool.py encode ...), flashed at address the tool has written
+# into config.bin.addr (the whole config area for fresh image, a single inactive sector for update image)
+CONFIG_BIN=./config.bin
+CONFIG_ADDR=0x3F9000
+CONFIG_ARGS=""
 
 if [ ! -c $PORT ]; then
   echo "ERROR: No USB tty device found"
@@ -12,8 +17,15 @@ fi
 
 echo
 echo "INFO: Before this step - please make sure to move jumper to \"FLASH\" pin and reset ESP"
+if [ -f $CONFIG_BIN ]; then
+  if [ -f "$CONFIG_BIN.addr" ]; then
+    CONFIG_ADDR=$(cat "$CONFIG_BIN.addr")
+  fi
+  echo "INFO: Using runtime configuration image: $CONFIG_BIN at $CONFIG_ADDR"
+  CONFIG_ARGS="$CONFIG_ADDR $CONFIG_BIN"
+fi
 echo -n "INFO: Flashing Firware ..."
-$PYTHON $ESP_TOOL --chip esp8266 --port $PORT --baud 115200 write_flash --flash_freq 20m --flash_mode dio --flash_size detect --verify 0x000000 "$FW_BIN_DIR/eagle.flash.bin" 0x010000 "$FW_BIN_DIR/eagle.irom0text.bin" 0x3FB000 "$FW_BIN_DIR/blank.bin" 0x3FC000 "$FW_BIN_DIR/esp_init_data_default_v08.bin" 0x3FE000 "$FW_BIN_DIR/blank.bin"
+$PYTHON $ESP_TOOL --chip esp8266 --port $PORT --baud 115200 write_flash --flash_freq 20m --flash_mode dio --flash_size detect --verify 0x000000 "$FW_BIN_DIR/eagle.flash.bin" 0x010000 "$FW_BIN_DIR/eagle.irom0text.bin" 0x3FB000 "$FW_BIN_DIR/blank.bin" 0x3FC000 "$FW_BIN_DIR/esp_init_data_default_v08.bin" 0x3FE000 "$FW_BIN_DIR/blank.bin" $CONFIG_ARGS
 if [ $? -eq "0" ]; then
   echo "INFO: Flashing is completed"
   echo "INFO: To run application please move jumper to \"EXEC\" pin and reset ESP module ..."
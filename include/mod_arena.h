@@ -0,0 +1,23 @@
+#ifndef INCLUDE_MOD_ARENA_H_
+#define INCLUDE_MOD_ARENA_H_
+
+#include <c_types.h>
+
+// Per-query arena size (bytes) - all short-lived HTTP request/response allocations are taken from it
+#define ARENA_SIZE                              2048
+#define ARENA_ALIGNMENT                         4
+
+#define ARENA_ALIGN(size)                       (((size) + ARENA_ALIGNMENT - 1) & ~(ARENA_ALIGNMENT - 1))
+
+// Compile-time budget check - fails to compile if condition is not met
+#define ARENA_STATIC_ASSERT(condition, name)    typedef char arena_static_assert_##name[(condition) ? 1 : -1]
+
+void* arena_alloc(size_t size);
+void* arena_zalloc(size_t size);
+size_t arena_mark(void);
+void arena_release(size_t mark);
+void arena_reset(void);
+size_t arena_used(void);
+size_t arena_high_water(void);
+
+#endif /* INCLUDE_MOD_ARENA_H_ */
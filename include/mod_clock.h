@@ -0,0 +1,33 @@
+#ifndef INCLUDE_MOD_CLOCK_H_
+#define INCLUDE_MOD_CLOCK_H_
+
+#include <c_types.h>
+
+// Clock restored from RTC memory is not trusted longer than this (seconds) after the last SNTP sync,
+// has to stay below RTC timer wrap-around period (about 7.5 hours)
+#define CLOCK_MAX_HOLDOVER                      21600
+// Earlier times (2023-01-01) are treated as bogus
+#define CLOCK_MIN_VALID_TIME                    1672531200
+// SDK clock deviation (seconds) from restored clock which is taken as SNTP response
+#define CLOCK_SYNC_TOLERANCE                    2
+
+#define CLOCK_SOURCE_NONE                       0	// no valid time yet
+#define CLOCK_SOURCE_RESTORED                   1	// time restored from RTC memory
+#define CLOCK_SOURCE_SNTP                       2	// time received from SNTP server
+
+struct clock_stats
+{
+	uint8 source;
+	// time since the last SNTP sync (seconds) of clock restored at boot
+	uint32 restored_age;
+	// boot - the first SNTP response (ms), 0 - no response yet
+	uint32 sntp_wait_time;
+};
+
+void clock_init(sint8 timezone);
+void clock_update(void);
+bool clock_is_ready(void);
+uint32 clock_get_local_time(void);
+const struct clock_stats* clock_get_stats(void);
+
+#endif /* INCLUDE_MOD_CLOCK_H_ */
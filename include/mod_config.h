@@ -0,0 +1,66 @@
+#ifndef INCLUDE_MOD_CONFIG_H_
+#define INCLUDE_MOD_CONFIG_H_
+
+#include <c_types.h>
+
+// Runtime configuration record stored in two consecutive flash sectors (double-buffered):
+// record with valid CRC and the highest sequence number is active, updates are written
+// to the other sector so power loss during update never destroys active record
+
+#define CONFIG_MAGIC                            0x464D4A54	// "TJMF"
+#define CONFIG_VERSION                          1
+#define CONFIG_SECTOR_SIZE                      0x1000
+#define CONFIG_SECTORS_COUNT                    2
+
+#define CONFIG_SSID_SIZE                        32
+#define CONFIG_PASSPHRASE_SIZE                  64
+#define CONFIG_KEY_SIZE                         64
+#define CONFIG_MAX_ROUTES                       8
+#define CONFIG_MAX_QUERIES                      CONFIG_MAX_ROUTES
+
+struct config_route
+{
+	sint32 best_time;
+	sint32 worst_time;
+	uint8 query_idx;
+	uint8 origin_idx;
+	uint8 destination_idx;
+	uint8 reserved;
+};
+
+struct config_query
+{
+	// request URL without key value (stored after record header, offset is 4-byte aligned)
+	uint16 url_offset;
+	uint16 url_len;
+	uint8 type;
+	uint8 route_idx;
+	uint8 leg_idx;
+	uint8 reserved;
+};
+
+// Record header (little-endian, no padding) - request URLs follow it within the same sector,
+// CRC-32 covers everything after 'crc' field up to 'size' bytes
+struct config_record
+{
+	uint32 magic;
+	uint16 version;
+	uint16 size;
+	uint32 sequence;
+	uint32 crc;
+	char wifi_ssid[CONFIG_SSID_SIZE];
+	char wifi_passphrase[CONFIG_PASSPHRASE_SIZE];
+	char api_key[CONFIG_KEY_SIZE];
+	uint8 routes_count;
+	uint8 queries_count;
+	uint16 reserved;
+	struct config_route routes[CONFIG_MAX_ROUTES];
+	struct config_query queries[CONFIG_MAX_QUERIES];
+};
+
+bool config_init(uint32 flash_addr);
+const struct config_record* config_get(void);
+bool config_load_url(uint8 query_idx, char* output, size_t output_size);
+bool config_save(const struct config_record* record);
+
+#endif /* INCLUDE_MOD_CONFIG_H_ */
@@ -0,0 +1,41 @@
+#ifndef INCLUDE_MOD_DISPLAY_H_
+#define INCLUDE_MOD_DISPLAY_H_
+
+#include <c_types.h>
+
+// Up to 8 daisy-chained 74HC595 registers (8 LEDs each)
+#define DISPLAY_MAX_LEDS                        64
+#define DISPLAY_FRAME_SIZE                      (DISPLAY_MAX_LEDS / 8)
+
+// Frame output: direct GPIO register writes (any pins), or HSPI peripheral
+// (data - GPIO13 / HSPID, clock - GPIO14 / HSPICLK, latch - any GPIO)
+#define DISPLAY_DRIVER_GPIO                     0
+#define DISPLAY_DRIVER_HSPI                     1
+
+// HSPI clock: 80 MHz / DISPLAY_HSPI_CLOCK_PREDIV / DISPLAY_HSPI_CLOCK_DIV (5 MHz)
+#define DISPLAY_HSPI_CLOCK_PREDIV               4
+#define DISPLAY_HSPI_CLOCK_DIV                  4
+
+struct display_config
+{
+	uint8 driver;
+	uint8 led_count;
+	uint8 data_pin;
+	uint8 clock_pin;
+	uint8 latch_pin;
+};
+
+struct display_stats
+{
+	uint32 frames_pushed;
+	uint32 frames_skipped;
+};
+
+void display_init(const struct display_config* config);
+void display_clear(void);
+void display_set(uint16 led, bool is_on);
+void display_fill(uint16 first_led, uint16 count, bool is_on);
+bool display_flush(void);
+const struct display_stats* display_get_stats(void);
+
+#endif /* INCLUDE_MOD_DISPLAY_H_ */
@@ -0,0 +1,32 @@
+#ifndef INCLUDE_MOD_DNS_H_
+#define INCLUDE_MOD_DNS_H_
+
+#include <c_types.h>
+
+#define DNS_CACHE_SIZE                          2
+#define DNS_CACHE_HOSTNAME_SIZE                 64
+// Cached address lifetime (seconds) - SDK DNS client does not expose record TTL,
+// so value is configured according to TTL published for target API hosts
+#define DNS_CACHE_TTL                           300
+
+struct dns_cache_entry
+{
+	char hostname[DNS_CACHE_HOSTNAME_SIZE];
+	uint32 addr;
+	uint32 expiry_time;
+	bool is_valid;
+};
+
+struct dns_cache_stats
+{
+	uint32 hits;
+	uint32 misses;
+	uint32 invalidations;
+};
+
+bool dns_cache_lookup(const char* hostname, uint32 now, uint32* output_addr);
+void dns_cache_store(const char* hostname, uint32 addr, uint32 ttl, uint32 now);
+void dns_cache_invalidate(const char* hostname);
+const struct dns_cache_stats* dns_cache_get_stats(void);
+
+#endif /* INCLUDE_MOD_DNS_H_ */
@@ -0,0 +1,49 @@
+#ifndef INCLUDE_MOD_EFFECTS_H_
+#define INCLUDE_MOD_EFFECTS_H_
+
+#include <c_types.h>
+
+#define EFFECT_CHANNEL_STATUS                   0
+#define EFFECT_CHANNEL_BAR                      1
+#define EFFECT_CHANNELS_COUNT                   2
+
+#define EFFECT_MAX_SEGMENTS                     8
+
+// Step operations
+#define EFFECT_OP_STATUS                        0	// status LED on (arg 1) or off (arg 0)
+#define EFFECT_OP_BAR_CLEAR                     1	// all bar LEDs off
+#define EFFECT_OP_BAR_LED                       2	// single bar LED on (arg - index counted from the far end)
+#define EFFECT_OP_BAR_PATTERN                   3	// 8-bit pattern (arg) repeated over the whole bar
+#define EFFECT_OP_BAR_LEVELS                    4	// moves shown segment levels one LED towards target levels,
+													// step is repeated until target levels are reached
+#define EFFECT_OP_BAR_MARKERS                   5	// shown levels with trend markers on (arg 1) or off (arg 0):
+													// LED above rising level is lit, top LED of falling level is off
+
+// Effect step: operation is applied, then channel waits for 'duration' ms
+struct effect_step
+{
+	uint8 op;
+	uint8 arg;
+	uint16 duration;
+};
+
+// Effect declared as data: non-looped effect stays at its last step once completed
+struct effect
+{
+	const struct effect_step* steps;
+	uint8 steps_count;
+	bool is_looped;
+};
+
+#define EFFECT_DECLARE(name, looped, ...) \
+	static const struct effect_step name##_STEPS[] = { __VA_ARGS__ }; \
+	static const struct effect name = { name##_STEPS, sizeof(name##_STEPS) / sizeof(struct effect_step), looped }
+
+void effects_init(uint8 status_pin, bool is_status_active_low, uint16 led_count);
+void effects_play(uint8 channel, const struct effect* effect);
+void effects_set_levels(const uint16* levels, uint8 segments_count, uint16 segment_size);
+void effects_skip_transition(void);
+void effects_set_markers(const sint8* directions, uint8 count);
+const struct effect* effects_current(uint8 channel);
+
+#endif /* INCLUDE_MOD_EFFECTS_H_ */
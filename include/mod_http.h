@@ -6,22 +6,42 @@
 #define HTTP_PATH_PREFIX                        "http://"
 #define HTTPS_PATH_PREFIX                       "https://"
 
-#define HTTP_TX_BUFFER_SIZE                     512
 #define HTTP_URL_BUFFER_SIZE                	512
-#define HTTP_HEADERS_BUFFER_SIZE                700
+// Request line and headers: path and hostname of URL plus fixed header text
+#define HTTP_TX_BUFFER_SIZE                     (HTTP_URL_BUFFER_SIZE + 128)
 #define HTTP_HEADER_BUFFER_SIZE                 256
+// Larger chunk sizes / Content-Length values are rejected (responses are tens of KB)
+#define HTTP_CHUNK_SIZE_MAX                     0x100000
+#define HTTP_CONTENT_LENGTH_MAX                 0x100000
 
 #define HTTP_HEADERS_NL                         "\r\n"
 #define HTTP_HEADERS_DELIM                      "\r\n\r\n"
 #define HTTP_HEADERS_TRANSFER_ENCODING          "Transfer-Encoding"
 #define HTTP_HEADERS_CONTENT_LENGTH             "Content-Length"
+#define HTTP_HEADERS_CONNECTION                 "Connection"
+#define HTTP_HEADERS_CONTENT_ENCODING           "Content-Encoding"
 
 #define HTTP_TRANSFER_ENCODING_CHUNKED          "chunked"
+#define HTTP_CONNECTION_CLOSE                   "close"
+#define HTTP_CONTENT_ENCODING_GZIP              "gzip"
 
 #define HTTP_PARSE_OK                           0
 #define HTTP_PARSE_ERROR_HEADERS                1
 #define HTTP_PARSE_ERROR_CONTENT_LENGTH         2
 #define HTTP_PARSE_ERROR_BLOCK_LENGTH           3
+#define HTTP_PARSE_ERROR_STATUS_LINE            4
+
+// Incremental HTTP response parser states
+#define HTTP_STATE_STATUS_LINE                  0
+#define HTTP_STATE_HEADER_LINE                  1
+#define HTTP_STATE_BODY                         2
+#define HTTP_STATE_CHUNK_SIZE                   3
+#define HTTP_STATE_CHUNK_DATA                   4
+#define HTTP_STATE_CHUNK_DATA_END               5
+#define HTTP_STATE_TRAILER                      6
+#define HTTP_STATE_BODY_UNTIL_CLOSE             7	// no Content-Length and no chunked encoding - body ends with connection
+#define HTTP_STATE_DONE                         8
+#define HTTP_STATE_ERROR                        9
 
 #define HTTP_URL_INVALID                       -1
 #define HTTP_URL_HTTP                           0
@@ -30,10 +50,40 @@
 #define SNTP_URL                                "pool.ntp.org"
 #define TLS_HANDSHAKE_BUFFER_SIZE               9800
 
-int parse_url(const char* const input_url, char* output_hostname, char* output_path);
-void parse_http_headers(const char* input_http_response, char* output_headers);
-void parse_http_header(const char* headers, const char* header_name, char* output_header_value);
-int parse_http_body(const char* input_http_response, char* output_body);
-bool is_end_of_content(const char* input_context);
+// Receives decoded (de-chunked) HTTP body bytes as they arrive
+typedef void (*http_body_callback)(void* arg, const char* data, size_t len);
+
+// Resumable HTTP/1.1 response parser - keeps its state between received TCP segments,
+// so each segment is processed only once and end of content is known without re-scanning
+struct http_response_parser
+{
+	uint8 state;
+	sint8 error;
+	bool is_chunked;
+	bool has_content_length;
+	// server is going to close connection after response (no keep-alive)
+	bool is_connection_close;
+	// body is compressed (Content-Encoding: gzip) - body callback receives compressed bytes
+	bool is_gzip;
+	uint16 status_code;
+	uint32 content_length;
+	// bytes left in the current body or chunk
+	uint32 remaining;
+	// size of status line and headers block (including final empty line)
+	uint32 header_size;
+	uint32 body_size;
+	uint16 line_len;
+	char line[HTTP_HEADER_BUFFER_SIZE];
+	http_body_callback on_body;
+	void* arg;
+};
+
+int parse_url(const char* const input_url, char* output_hostname, size_t hostname_size, char* output_path, size_t path_size);
+int http_body_view(char* http_response, size_t http_response_len, char** output_body, size_t* output_body_len);
+
+void http_parser_init(struct http_response_parser* parser, http_body_callback on_body, void* arg);
+int http_parser_feed(struct http_response_parser* parser, const char* data, size_t len);
+bool http_parser_is_complete(const struct http_response_parser* parser);
+void http_parser_finish(struct http_response_parser* parser);
 
 #endif /* INCLUDE_MOD_HTTP_H_ */
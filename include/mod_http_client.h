@@ -0,0 +1,87 @@
+#ifndef INCLUDE_MOD_HTTP_CLIENT_H_
+#define INCLUDE_MOD_HTTP_CLIENT_H_
+
+#include <c_types.h>
+
+#include "mod_http.h"
+#include "mod_inflate.h"
+
+// Connection pool size - upper limit of parallel connections (see http_client_init)
+#define HTTP_CLIENT_MAX_CONNECTIONS             2
+// SDK secure espconn API handles a single TLS client connection at a time
+#define HTTP_CLIENT_MAX_SECURE_CONNECTIONS      1
+// Socket is closed with a delay once response is received (ms) - espconn is never disconnected from its own callbacks
+#define HTTP_CLIENT_CLOSE_DELAY                 100
+// Free heap (bytes) left aside when inflate history window is sized - window is the largest one fitting into
+// the rest of free heap once connection is set up (compressed response is not requested if none fits)
+#define HTTP_CLIENT_GZIP_HEAP_RESERVE           4096
+
+// Request results (passed to completion callback)
+#define HTTP_RESULT_OK                          0	// complete response received (any status code)
+#define HTTP_RESULT_ERROR_DNS                   1	// hostname could not be resolved
+#define HTTP_RESULT_ERROR_CONNECTION            2	// TCP connect / TLS handshake failed or connection was reset
+#define HTTP_RESULT_ERROR_RESPONSE              3	// connection closed before complete response, or malformed response
+#define HTTP_RESULT_ERROR_INFLATE               4	// requested gzip response could not be inflated (gzip is not requested until identity response succeeds)
+
+// Request states
+#define HTTP_REQUEST_IDLE                       0	// not submitted yet or completed
+#define HTTP_REQUEST_QUEUED                     1	// waiting for a free connection
+#define HTTP_REQUEST_ACTIVE                     2	// DNS lookup, connect, or transfer in progress
+
+struct http_request;
+
+// Triggered once request is completed (request context is idle again and can be re-submitted)
+typedef void (*http_request_callback)(struct http_request* request, uint8 result);
+
+// Request context - owned by caller, it has to stay in place until completion callback is triggered
+struct http_request
+{
+	// options (set before submission)
+	bool is_keep_alive;
+	bool is_gzip;
+	// receives plain (de-chunked and inflated) response body bytes
+	http_body_callback on_body;
+	http_request_callback on_complete;
+	void* arg;
+	// request state (read only)
+	uint8 state;
+	uint8 url_type;
+	// sent over connection kept alive after previous request
+	bool is_connection_reused;
+	// re-submitted with full handshake once reused connection turned out to be dropped
+	bool is_retried;
+	bool is_gzip_requested;
+	// history window size of requested compressed response (bits)
+	uint8 window_bits;
+	// espconn error of failed connection
+	sint8 connection_error;
+	// TCP connect and TLS handshake duration (us, 0 - connection reused)
+	uint32 handshake_duration;
+	uint32 min_free_heap;
+	char hostname[HTTP_HEADER_BUFFER_SIZE];
+	// path of request URL (with query string)
+	char path[HTTP_URL_BUFFER_SIZE];
+	struct http_response_parser parser;
+	// decoder of compressed response body (history window is allocated while body is received)
+	struct inflate_stream inflater;
+	struct http_request* next;
+};
+
+struct http_client_stats
+{
+	uint32 requests;
+	uint32 reused;
+	uint32 retries;
+	uint32 failures;
+	// the largest number of connections open at the same time
+	uint8 peak_connections;
+	// set once requested compressed response could not be inflated, cleared by successful identity response
+	bool is_gzip_disabled;
+};
+
+void http_client_init(uint8 max_connections);
+void http_request_init(struct http_request* request, http_body_callback on_body, http_request_callback on_complete, void* arg);
+bool http_client_submit(struct http_request* request, const char* url);
+const struct http_client_stats* http_client_get_stats(void);
+
+#endif /* INCLUDE_MOD_HTTP_CLIENT_H_ */
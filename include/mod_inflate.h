@@ -0,0 +1,96 @@
+#ifndef INCLUDE_MOD_INFLATE_H_
+#define INCLUDE_MOD_INFLATE_H_
+
+#include <c_types.h>
+
+// History window size (as power of two) - deflate allows back references up to 32 KB,
+// responses referencing data older than the window are reported with INFLATE_ERROR_DISTANCE
+#define INFLATE_WINDOW_BITS_MIN                 8
+#define INFLATE_WINDOW_BITS_MAX                 15
+// the smallest window compressed response is worth requesting with (8 KB) - window is sized to free heap
+// by inflate_fit_window_bits, typical Google API response refers 8 - 32 KB back
+#define INFLATE_WINDOW_BITS                     13
+
+#define INFLATE_MAX_LITLEN_CODES                288
+#define INFLATE_MAX_DIST_CODES                  30
+#define INFLATE_MAX_CODE_BITS                   15
+#define INFLATE_MAX_CODE_LENGTHS                (286 + 30)
+
+#define INFLATE_OK                              0
+#define INFLATE_ERROR_HEADER                    1
+#define INFLATE_ERROR_BLOCK                     2
+#define INFLATE_ERROR_CODES                     3
+#define INFLATE_ERROR_DISTANCE                  4
+#define INFLATE_ERROR_CHECKSUM                  5
+#define INFLATE_ERROR_MEMORY                    6
+
+// Streaming inflater states (gzip member header, deflate blocks, gzip trailer)
+#define INFLATE_STATE_GZIP_HEADER               0
+#define INFLATE_STATE_GZIP_EXTRA_LEN            1
+#define INFLATE_STATE_GZIP_EXTRA                2
+#define INFLATE_STATE_GZIP_NAME                 3
+#define INFLATE_STATE_GZIP_COMMENT              4
+#define INFLATE_STATE_GZIP_HEADER_CRC           5
+#define INFLATE_STATE_BLOCK_HEADER              6
+#define INFLATE_STATE_STORED_LEN                7
+#define INFLATE_STATE_STORED_DATA               8
+#define INFLATE_STATE_TABLE_SIZES               9
+#define INFLATE_STATE_CODE_LENS                 10
+#define INFLATE_STATE_LENS                      11
+#define INFLATE_STATE_LENS_REPEAT               12
+#define INFLATE_STATE_LITLEN                    13
+#define INFLATE_STATE_LENGTH_EXTRA              14
+#define INFLATE_STATE_DIST                      15
+#define INFLATE_STATE_DIST_EXTRA                16
+#define INFLATE_STATE_TRAILER                   17
+#define INFLATE_STATE_DONE                      18
+#define INFLATE_STATE_ERROR                     19
+
+// Receives inflated bytes (contiguous runs of history window)
+typedef void (*inflate_output_callback)(void* arg, const char* data, size_t len);
+
+// Resumable gzip decoder - compressed input may be split at any byte, decoder keeps
+// partially read bits and its position within the block between feed calls.
+// Only history window is heap-allocated (for the duration of one response body)
+struct inflate_stream
+{
+	uint8 state;
+	sint8 error;
+	uint8 window_bits;
+	uint8 gzip_flags;
+	bool is_last_block;
+	uint8 bit_count;
+	uint32 bit_buffer;
+	// generic counter of current state (header bytes, code lengths read, etc.)
+	uint16 count;
+	uint16 symbol;
+	uint16 length;
+	uint16 nlen;
+	uint16 ndist;
+	uint16 ncode;
+	uint32 trailer;
+	uint32 crc;
+	uint32 total_out;
+	// farthest back reference seen so far (used to choose window size)
+	uint16 max_distance;
+	uint8* window;
+	uint16 window_pos;
+	uint16 flushed_pos;
+	const uint8* input;
+	const uint8* input_end;
+	uint8 lengths[INFLATE_MAX_CODE_LENGTHS];
+	uint16 litlen_counts[INFLATE_MAX_CODE_BITS + 1];
+	uint16 litlen_symbols[INFLATE_MAX_LITLEN_CODES];
+	uint16 dist_counts[INFLATE_MAX_CODE_BITS + 1];
+	uint16 dist_symbols[INFLATE_MAX_DIST_CODES];
+	inflate_output_callback on_output;
+	void* arg;
+};
+
+uint8 inflate_fit_window_bits(uint32 available);
+bool inflate_init(struct inflate_stream* stream, uint8 window_bits, inflate_output_callback on_output, void* arg);
+int inflate_feed(struct inflate_stream* stream, const char* data, size_t len);
+bool inflate_is_complete(const struct inflate_stream* stream);
+void inflate_release(struct inflate_stream* stream);
+
+#endif /* INCLUDE_MOD_INFLATE_H_ */
@@ -0,0 +1,108 @@
+#ifndef INCLUDE_MOD_JSON_H_
+#define INCLUDE_MOD_JSON_H_
+
+#include <c_types.h>
+#include <stddef.h>
+
+// Maximum nesting depth for which keys and array indices are tracked
+#define JSON_STREAM_MAX_DEPTH                   8
+// Maximum total nesting depth accepted by the tokenizer
+#define JSON_STREAM_MAX_NESTING                 32
+#define JSON_STREAM_KEY_SIZE                    24
+#define JSON_STREAM_TOKEN_SIZE                  32
+// Marks a key which is too long to be tracked (never matches any path)
+#define JSON_STREAM_KEY_OVERFLOW                0xFF
+
+#define JSON_VALUE_STRING                       1
+#define JSON_VALUE_NUMBER                       2
+#define JSON_VALUE_LITERAL                      3
+
+// Maximum number of fields in a field table
+#define JSON_FIELDS_MAX                         32
+// Array index path segment matching any index
+#define JSON_INDEX_ANY                          0xFFFF
+// Reported value does not match any field of field table
+#define JSON_FIELD_NONE                         0xFF
+
+// Field kinds - how matching value is stored into result structure
+#define JSON_FIELD_NUMBER                       0	// number stored as sint32
+#define JSON_FIELD_NUMBER_SUM                   1	// numbers at all matching positions (e.g. '[*]' index) summed as sint32
+#define JSON_FIELD_STRING                       2	// zero-terminated string, truncated to member size
+#define JSON_FIELD_NOTIFY                       3	// nothing stored, value is only reported with field index
+
+// Path segment: object key, or array index (key is NULL)
+struct json_segment
+{
+	const char* key;
+	uint8 key_len;
+	uint16 index;
+};
+
+#define JSON_KEY(name)                          { name, sizeof(name) - 1, 0 }
+#define JSON_INDEX(index)                       { NULL, 0, index }
+#define JSON_ANY_INDEX                          { NULL, 0, JSON_INDEX_ANY }
+
+#define JSON_PATH_DECLARE(name, ...) \
+	static const struct json_segment name[] = { __VA_ARGS__ }
+
+// Field of field table: value found at path is stored into result structure member at 'offset'
+struct json_field
+{
+	const struct json_segment* path;
+	uint8 depth;
+	uint8 kind;
+	uint16 offset;
+	uint16 size;
+};
+
+#define JSON_FIELD(path, kind, result_type, member) \
+	{ path, sizeof(path) / sizeof(struct json_segment), kind, offsetof(result_type, member), sizeof(((result_type*)0)->member) }
+#define JSON_FIELD_NOTIFY_DECLARE(path) \
+	{ path, sizeof(path) / sizeof(struct json_segment), JSON_FIELD_NOTIFY, 0, 0 }
+
+struct json_stream;
+
+// Receives every scalar value (string, number, true/false/null) found in the document
+typedef void (*json_value_callback)(void* arg, const struct json_stream* stream, uint8 type, const char* value, size_t len);
+
+struct json_stream_level
+{
+	uint16 index;
+	uint8 key_len;
+	char key[JSON_STREAM_KEY_SIZE];
+};
+
+// Push-style JSON tokenizer - consumes document bytes as they arrive and keeps only
+// the current path (keys and array indices) in a fixed amount of memory
+struct json_stream
+{
+	uint8 state;
+	uint8 depth;
+	bool is_key;
+	uint8 token_len;
+	// bit N set - container at depth N is an array, otherwise an object
+	uint32 array_bits;
+	char token[JSON_STREAM_TOKEN_SIZE];
+	struct json_stream_level levels[JSON_STREAM_MAX_DEPTH];
+	json_value_callback on_value;
+	void* arg;
+	// field table (optional): matching state is advanced on each key / array element, so every value
+	// is matched against all fields in a single pass
+	const struct json_field* fields;
+	uint8 fields_count;
+	// field matched by reported value (JSON_FIELD_NONE if none)
+	uint8 field_idx;
+	void* result;
+	// bit N set - field N has been found
+	uint32 fields_found;
+	// bit N of entry D set - path of field N matches current path up to depth D
+	uint32 field_bits[JSON_STREAM_MAX_DEPTH + 1];
+};
+
+void json_stream_init(struct json_stream* stream, json_value_callback on_value, void* arg);
+bool json_stream_feed(struct json_stream* stream, const char* data, size_t len);
+bool json_stream_match(const struct json_stream* stream, const char* path, uint16* indices);
+void json_stream_set_fields(struct json_stream* stream, const struct json_field* fields, uint8 fields_count, void* result);
+uint8 json_stream_field_indices(const struct json_stream* stream, uint16* indices);
+
+#endif /* INCLUDE_MOD_JSON_H_ */
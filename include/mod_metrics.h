@@ -0,0 +1,79 @@
+#ifndef INCLUDE_MOD_METRICS_H_
+#define INCLUDE_MOD_METRICS_H_
+
+#include <c_types.h>
+
+// Query phases
+#define METRICS_PHASE_DNS                       0	// hostname resolution (DNS cache hits are not counted)
+#define METRICS_PHASE_CONNECT                   1	// TCP connect and TLS handshake
+#define METRICS_PHASE_FIRST_BYTE                2	// request sent - first response byte
+#define METRICS_PHASE_DOWNLOAD                  3	// first response byte - complete response
+#define METRICS_PHASE_PARSE                     4	// CPU time of HTTP / gzip / JSON parsing plus result processing
+#define METRICS_PHASE_QUERY                     5	// whole query (successful queries only)
+#define METRICS_PHASES_COUNT                    6
+
+// Average smoothing factor (1 / 2^METRICS_EWMA_SHIFT of each new sample)
+#define METRICS_EWMA_SHIFT                      3
+
+// Durations in us, phase still in progress when query is finished is counted as failure
+struct metrics_phase
+{
+	uint32 count;
+	uint32 failures;
+	uint32 last;
+	uint32 min;
+	uint32 avg;
+	uint32 max;
+};
+
+struct metrics
+{
+	struct metrics_phase phases[METRICS_PHASES_COUNT];
+	// free heap minimum over current (last) query and since boot
+	uint32 query_min_free_heap;
+	uint32 min_free_heap;
+	// TCP payload bytes received within current (last) query and since boot
+	uint32 query_bytes_received;
+	uint32 bytes_received;
+};
+
+// Instrumentation is compiled in only when building with UNIVERSAL_TARGET_DEFINES=-DQUERY_METRICS,
+// otherwise macros expand to nothing
+#ifdef QUERY_METRICS
+
+void metrics_begin(uint8 phase);
+void metrics_end(uint8 phase);
+void metrics_fail(uint8 phase);
+void metrics_pause(uint8 phase);
+void metrics_resume(uint8 phase);
+void metrics_heap(void);
+void metrics_bytes(uint32 len);
+void metrics_finish_query(void);
+void metrics_print(void);
+const struct metrics* metrics_get(void);
+
+#define METRICS_BEGIN(phase)                    metrics_begin(phase)
+#define METRICS_END(phase)                      metrics_end(phase)
+#define METRICS_FAIL(phase)                     metrics_fail(phase)
+#define METRICS_PAUSE(phase)                    metrics_pause(phase)
+#define METRICS_RESUME(phase)                   metrics_resume(phase)
+#define METRICS_HEAP()                          metrics_heap()
+#define METRICS_BYTES(len)                      metrics_bytes(len)
+#define METRICS_FINISH_QUERY()                  metrics_finish_query()
+#define METRICS_PRINT()                         metrics_print()
+
+#else
+
+#define METRICS_BEGIN(phase)
+#define METRICS_END(phase)
+#define METRICS_FAIL(phase)
+#define METRICS_PAUSE(phase)
+#define METRICS_RESUME(phase)
+#define METRICS_HEAP()
+#define METRICS_BYTES(len)
+#define METRICS_FINISH_QUERY()
+#define METRICS_PRINT()
+
+#endif
+
+#endif /* INCLUDE_MOD_METRICS_H_ */
@@ -0,0 +1,55 @@
+#ifndef INCLUDE_MOD_POLL_H_
+#define INCLUDE_MOD_POLL_H_
+
+#include <c_types.h>
+
+#define POLL_SECONDS_PER_DAY                    86400
+#define POLL_SECONDS_PER_HOUR                   3600
+// Volatility smoothing factor (1 / 2^POLL_EWMA_SHIFT of each new sample)
+#define POLL_EWMA_SHIFT                         2
+// Remaining daily budget may be spent up to this many times faster than even pace
+// (pace slows down as budget runs low, no requests are made once it is exhausted)
+#define POLL_BUDGET_BURST                       4
+
+// Time-of-day window overriding interval limits (minutes since local midnight,
+// window with start later than end wraps around midnight)
+struct poll_window
+{
+	uint16 start_minute;
+	uint16 end_minute;
+	uint16 min_interval;
+	uint16 max_interval;
+};
+
+struct poll_config
+{
+	// query interval limits (seconds)
+	uint16 min_interval;
+	uint16 max_interval;
+	// maximal number of billed requests per day (each Distance Matrix element counts as one)
+	uint16 daily_budget;
+	// route time change (seconds) worth a new query - next query is expected to see about this change
+	uint16 target_change;
+	const struct poll_window* windows;
+	uint8 windows_count;
+};
+
+struct poll_stats
+{
+	// smoothed route time change rate (seconds of route time per hour)
+	uint32 volatility;
+	uint32 last_interval;
+	uint16 requests_today;
+	// day is counted from wall clock rather than from uptime
+	bool is_wall_day;
+	uint32 day;
+};
+
+void poll_init(const struct poll_config* config);
+void poll_on_request(uint32 now, uint32 timestamp, uint16 requests);
+void poll_on_result(uint32 now, uint32 change);
+uint32 poll_next_interval(uint32 now, uint32 timestamp, uint16 requests_per_update);
+const struct poll_stats* poll_get_stats(void);
+void poll_restore(const struct poll_stats* stats);
+
+#endif /* INCLUDE_MOD_POLL_H_ */
@@ -0,0 +1,58 @@
+#ifndef INCLUDE_MOD_ROUTES_H_
+#define INCLUDE_MOD_ROUTES_H_
+
+#include <c_types.h>
+
+// Route tables are generated from config/routes.json by tools/gen_routes.py (`make routes`)
+// into include/routes_gen.h - request URLs are precomposed and stored in flash
+
+#define ROUTE_QUERY_DIRECTIONS                  0
+#define ROUTE_QUERY_DISTANCE_MATRIX             1
+
+// route index of Distance Matrix query (response covers several routes)
+#define ROUTE_QUERY_BATCH                       0xFF
+// maximum number of legs of a route with per-leg thresholds - each leg is queried with own single-element
+// Distance Matrix request (route_idx and leg_idx are set), route refers to its last leg query
+#define ROUTE_MAX_LEGS                          8
+// the last parameter of generated request URLs (followed by API key value)
+#define ROUTES_KEY_PARAM                        "&key="
+
+struct route_leg
+{
+	sint32 best_time;
+	sint32 worst_time;
+};
+
+struct route_info
+{
+	// best time on the route (in seconds) - all warning LEDs will be off - means road is free
+	sint32 best_time;
+	// worst time on the route (in seconds) - all warning LEDs will be ignited - means traffic jam
+	sint32 worst_time;
+	// index of query plan entry which queries the route
+	uint8 query_idx;
+	// unique origin / destination index within Distance Matrix request (batched routes only)
+	uint8 origin_idx;
+	uint8 destination_idx;
+	// legs with own thresholds (0 - route is shown as a whole), index of the first one in ROUTE_LEGS
+	uint8 legs_count;
+	uint8 first_leg_idx;
+};
+
+struct route_query
+{
+	// complete request URL (flash-resident, 4-byte aligned)
+	const char* url;
+	uint16 url_len;
+	uint8 type;
+	// queried route index (ROUTE_QUERY_BATCH for Distance Matrix query)
+	uint8 route_idx;
+	// queried leg index (Distance Matrix query of route with legs, 0 otherwise)
+	uint8 leg_idx;
+	// billed requests (Distance Matrix is billed per element - origins x destinations, Directions per request)
+	uint16 elements;
+};
+
+bool routes_load_url(const struct route_query* query, const char* api_key, char* output, size_t output_size);
+
+#endif /* INCLUDE_MOD_ROUTES_H_ */
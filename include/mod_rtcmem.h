@@ -0,0 +1,26 @@
+#ifndef INCLUDE_MOD_RTCMEM_H_
+#define INCLUDE_MOD_RTCMEM_H_
+
+#include <c_types.h>
+
+// RTC user memory (kept across resets and deep sleep, lost on power loss) is split into
+// fixed slots, each slot holds one checksummed record
+
+// first 4-byte block of user area (blocks 0 - 63 are reserved by SDK), user area size
+#define RTCMEM_USER_BLOCK                       64
+#define RTCMEM_USER_SIZE                        512
+#define RTCMEM_SLOT_SIZE                        128
+#define RTCMEM_SLOTS_COUNT                      (RTCMEM_USER_SIZE / RTCMEM_SLOT_SIZE)
+#define RTCMEM_SLOT_HEADER_SIZE                 8
+#define RTCMEM_SLOT_DATA_SIZE                   (RTCMEM_SLOT_SIZE - RTCMEM_SLOT_HEADER_SIZE)
+#define RTCMEM_MAGIC                            0x5254
+
+// Slot assignment
+#define RTCMEM_SLOT_DISPLAY_STATE               0
+#define RTCMEM_SLOT_STATION                     1
+#define RTCMEM_SLOT_CLOCK                       2
+
+bool rtcmem_read(uint8 slot, void* data, uint16 size);
+bool rtcmem_write(uint8 slot, const void* data, uint16 size);
+
+#endif /* INCLUDE_MOD_RTCMEM_H_ */
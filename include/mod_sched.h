@@ -0,0 +1,42 @@
+#ifndef INCLUDE_MOD_SCHED_H_
+#define INCLUDE_MOD_SCHED_H_
+
+#include <c_types.h>
+
+#define SCHED_MAX_TASKS                         14
+#define SCHED_INVALID_TASK                      -1
+// Longest single timer sleep (ms) - monotonic clock is also advanced at least this often,
+// since SDK system time wraps around every ~71 minutes
+#define SCHED_MAX_SLEEP_MS                      60000
+
+typedef void (*sched_task_callback)(void* arg);
+
+struct sched_task
+{
+	const char* name;
+	sched_task_callback callback;
+	void* arg;
+	// monotonic time (ms) the task is due at
+	uint64 deadline;
+	// repeat period (ms), 0 - one-shot task
+	uint32 period;
+	uint32 run_count;
+	bool is_pending;
+};
+
+struct sched_stats
+{
+	uint32 wakeups;
+	uint32 task_runs;
+};
+
+void sched_init(void);
+sint8 sched_add(const char* name, sched_task_callback callback, void* arg, uint32 period);
+void sched_set_deadline(sint8 task_id, uint32 delay);
+void sched_cancel(sint8 task_id);
+bool sched_is_pending(sint8 task_id);
+const struct sched_task* sched_get_task(sint8 task_id);
+const struct sched_stats* sched_get_stats(void);
+uint64 sched_now_ms(void);
+
+#endif /* INCLUDE_MOD_SCHED_H_ */
@@ -0,0 +1,29 @@
+#ifndef INCLUDE_MOD_STATION_H_
+#define INCLUDE_MOD_STATION_H_
+
+#include <c_types.h>
+#include <user_interface.h>
+
+// Directed connect to cached access point is given up after this time (ms), regular scan + DHCP connect follows
+#define STATION_FAST_CONNECT_TIMEOUT            3000
+// Cached DHCP lease is used as static IP for at most this time since it was obtained (seconds) - lease time
+// is not reported by SDK, so it stays well below common router lease times; regular connect renews the cache
+#define STATION_CACHE_MAX_AGE                   3600
+
+// Connect times (ms) are measured from connect command to station getting IP address
+struct station_stats
+{
+	uint32 fast_connects;
+	uint32 scan_connects;
+	uint32 fallbacks;
+	uint32 last_fast_connect_time;
+	uint32 last_scan_connect_time;
+	bool is_last_connect_fast;
+};
+
+void station_init(void);
+bool station_connect(struct station_config* config);
+void station_on_event(const System_Event_t* event);
+const struct station_stats* station_get_stats(void);
+
+#endif /* INCLUDE_MOD_STATION_H_ */
@@ -0,0 +1,26 @@
+#ifndef INCLUDE_MOD_STATUS_H_
+#define INCLUDE_MOD_STATUS_H_
+
+#include <c_types.h>
+
+#define STATUS_SERVER_PORT                      80
+// Response buffer (statically allocated), space reserved in front of body for HTTP header
+#define STATUS_BUFFER_SIZE                      1024
+#define STATUS_HEADER_RESERVE                   128
+#define STATUS_BODY_SIZE                        (STATUS_BUFFER_SIZE - STATUS_HEADER_RESERVE)
+// Idle client connection timeout (seconds)
+#define STATUS_TIMEOUT                          5
+
+// Renders JSON body into 'output' (at most 'size' bytes), returns body length
+typedef uint16 (*status_render_callback)(char* output, uint16 size);
+
+struct status_server_stats
+{
+	uint32 requests;
+	uint32 rejected;
+};
+
+bool status_server_init(uint16 port, status_render_callback render);
+const struct status_server_stats* status_server_get_stats(void);
+
+#endif /* INCLUDE_MOD_STATUS_H_ */
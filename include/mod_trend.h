@@ -0,0 +1,40 @@
+#ifndef INCLUDE_MOD_TREND_H_
+#define INCLUDE_MOD_TREND_H_
+
+#include <c_types.h>
+
+// Number of recent samples kept per route
+#define TREND_HISTORY_SIZE                      8
+// Slope smoothing factor (1 / 2^TREND_EWMA_SHIFT of each new sample)
+#define TREND_EWMA_SHIFT                        1
+// Samples older than this (seconds) are dropped before new sample is added
+#define TREND_MAX_AGE                           3600
+// Prediction is not extrapolated further than this (seconds) after the latest sample
+#define TREND_MAX_HORIZON                       900
+
+#define TREND_FALLING                           -1
+#define TREND_STABLE                            0
+#define TREND_RISING                            1
+
+struct trend_sample
+{
+	// monotonic time (seconds)
+	uint32 time;
+	sint32 duration;
+};
+
+// Route time history: ring of recent samples and smoothed slope (route seconds per hour)
+struct trend
+{
+	struct trend_sample samples[TREND_HISTORY_SIZE];
+	uint8 head;
+	uint8 count;
+	sint32 slope;
+};
+
+void trend_init(struct trend* trend);
+void trend_add(struct trend* trend, uint32 now, sint32 duration);
+bool trend_predict(const struct trend* trend, uint32 now, sint32* output_duration);
+sint8 trend_direction(const struct trend* trend, sint32 min_change);
+
+#endif /* INCLUDE_MOD_TREND_H_ */
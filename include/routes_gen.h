@@ -0,0 +1,38 @@
+// Generated by tools/gen_routes.py from config/routes.json - do not edit, run `make routes` instead
+#ifndef INCLUDE_ROUTES_GEN_H_
+#define INCLUDE_ROUTES_GEN_H_
+
+#include "mod_routes.h"
+
+#ifndef HTTP_QUERY_KEY
+#error "HTTP_QUERY_KEY has to be defined before routes_gen.h is included"
+#endif
+
+#define ROUTE_COUNT                             1
+#define QUERY_PLAN_SIZE                         1
+// billed requests per update (Distance Matrix elements, Directions requests)
+#define QUERY_PLAN_ELEMENTS                     1
+#define ROUTE_LEGS_COUNT                        0
+
+// Directions: route 0 (2 waypoints)
+static const char ROUTE_QUERY_0_URL[] ICACHE_RODATA_ATTR STORE_ATTR =
+		"https://maps.googleapis.com/maps/api/directions/json?origin=51.564418%2C-0.062658&waypoints=via%3A51.556724%2C-0.074518%7Cvia%3A51.531606%2C-0.077044&destination=51.519986%2C-0.082895&departure_time=now&key=" HTTP_QUERY_KEY;
+
+static const struct route_query QUERY_PLAN[QUERY_PLAN_SIZE] =
+{
+		{ ROUTE_QUERY_0_URL, sizeof(ROUTE_QUERY_0_URL) - 1, ROUTE_QUERY_DIRECTIONS, 0, 0, 1 }
+};
+
+// { best time, worst time } of route legs (a single unused entry if no route defines legs)
+static const struct route_leg ROUTE_LEGS[1] =
+{
+		{ 0, 0 }
+};
+
+// { best time, worst time, query index, origin index, destination index, legs count, first leg index }
+static const struct route_info ROUTES[ROUTE_COUNT] =
+{
+		{ 960, 1600, 0, 0, 0, 0, 0 }
+};
+
+#endif /* INCLUDE_ROUTES_GEN_H_ */
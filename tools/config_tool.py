@@ -0,0 +1,197 @@
+#!/usr/bin/env python3
+# Encodes / decodes runtime configuration flash image (two config sectors, see include/mod_config.h).
+# Usage:
+#   config_tool.py encode config/routes.json config.bin --ssid SSID --passphrase PASS --key KEY [--sequence N] [--update CURRENT]
+#   config_tool.py decode config.bin
+# Fresh image covers both sectors, update image (--update) is a single sector - its flash address is written
+# next to it into <output>.addr (flash_mem_non_ota.sh picks it up)
+
+import argparse
+import struct
+import sys
+import zlib
+
+import gen_routes
+
+# the same as CONFIG_PARTITION_ADDR of user/user_main.c
+CONFIG_PARTITION_ADDR = 0x3F9000
+CONFIG_MAGIC = 0x464D4A54
+CONFIG_VERSION = 1
+CONFIG_SECTOR_SIZE = 0x1000
+CONFIG_SECTORS_COUNT = 2
+CONFIG_SSID_SIZE = 32
+CONFIG_PASSPHRASE_SIZE = 64
+CONFIG_KEY_SIZE = 64
+CONFIG_MAX_ROUTES = 8
+CONFIG_MAX_QUERIES = CONFIG_MAX_ROUTES
+
+ROUTE_QUERY_TYPES = {"ROUTE_QUERY_DIRECTIONS": 0, "ROUTE_QUERY_DISTANCE_MATRIX": 1}
+ROUTE_QUERY_BATCH = 0xFF
+
+# struct config_record (little-endian, no padding)
+HEADER_FORMAT = "<IHHII%ds%ds%dsBBH" % (CONFIG_SSID_SIZE, CONFIG_PASSPHRASE_SIZE, CONFIG_KEY_SIZE)
+ROUTE_FORMAT = "<iiBBBB"
+QUERY_FORMAT = "<HHBBBB"
+RECORD_SIZE = (struct.calcsize(HEADER_FORMAT) +
+               CONFIG_MAX_ROUTES * struct.calcsize(ROUTE_FORMAT) +
+               CONFIG_MAX_QUERIES * struct.calcsize(QUERY_FORMAT))
+CRC_OFFSET = 16
+
+
+def encode_string(value, size, name):
+    data = value.encode("utf-8")
+    if len(data) >= size:
+        gen_routes.fail("%s exceeds %d bytes" % (name, size - 1))
+    return data
+
+
+def read_sector_record(data):
+    """Returns (sequence, size) of valid record stored in sector data, None if sector holds no valid record"""
+    magic, version, size, sequence, crc = struct.unpack_from("<IHHII", data)
+    if magic != CONFIG_MAGIC or version != CONFIG_VERSION or not RECORD_SIZE <= size <= CONFIG_SECTOR_SIZE:
+        return None
+    if zlib.crc32(data[CRC_OFFSET:size]) & 0xFFFFFFFF != crc:
+        return None
+    return sequence, size
+
+
+def find_active_sector(image):
+    """Index and sequence of the record firmware would load (valid one with the highest sequence)"""
+    active = None
+    for sector in range(CONFIG_SECTORS_COUNT):
+        record = read_sector_record(image[sector * CONFIG_SECTOR_SIZE:(sector + 1) * CONFIG_SECTOR_SIZE])
+        # sequence comparison is wrap-around safe, the same way as in config_init
+        if record and (active is None or 0 < (record[0] - active[1]) & 0xFFFFFFFF <= 0x7FFFFFFF):
+            active = (sector, record[0])
+    return active
+
+
+def encode(args):
+    _, routes = gen_routes.load_routes(args.routes)
+    plan = gen_routes.build_query_plan(routes)
+    if len(routes) > CONFIG_MAX_ROUTES:
+        gen_routes.fail("too many routes for config record (%d, max %d)" % (len(routes), CONFIG_MAX_ROUTES))
+    if len(plan) > CONFIG_MAX_QUERIES:
+        gen_routes.fail("too many queries for config record (%d, max %d)" % (len(plan), CONFIG_MAX_QUERIES))
+    routes_data = b""
+    for route in routes:
+        routes_data += struct.pack(ROUTE_FORMAT, route["best_time"], route["worst_time"],
+                                   route["query_idx"], route["origin_idx"], route["destination_idx"], 0)
+    routes_data += b"\0" * struct.calcsize(ROUTE_FORMAT) * (CONFIG_MAX_ROUTES - len(routes))
+    # URL area follows header, each URL starts at 4-byte aligned offset
+    urls_data = b""
+    queries_data = b""
+    for query in plan:
+        url = query["url"].encode("ascii")
+        offset = RECORD_SIZE + len(urls_data)
+        route_idx = ROUTE_QUERY_BATCH if query["route_idx"] == "ROUTE_QUERY_BATCH" else int(query["route_idx"])
+        queries_data += struct.pack(QUERY_FORMAT, offset, len(url), ROUTE_QUERY_TYPES[query["type"]], route_idx,
+                                    query["leg_idx"], 0)
+        urls_data += url + b"\0" * (4 - len(url) % 4)
+    queries_data += b"\0" * struct.calcsize(QUERY_FORMAT) * (CONFIG_MAX_QUERIES - len(plan))
+    size = RECORD_SIZE + len(urls_data)
+    if size > CONFIG_SECTOR_SIZE:
+        gen_routes.fail("config record exceeds flash sector (%d bytes)" % size)
+    body = struct.pack("<%ds%ds%dsBBH" % (CONFIG_SSID_SIZE, CONFIG_PASSPHRASE_SIZE, CONFIG_KEY_SIZE),
+                       encode_string(args.ssid, CONFIG_SSID_SIZE, "SSID"),
+                       encode_string(args.passphrase, CONFIG_PASSPHRASE_SIZE, "passphrase"),
+                       encode_string(args.key, CONFIG_KEY_SIZE, "API key"),
+                       len(routes), len(plan), 0)
+    body += routes_data + queries_data + urls_data
+    sector = 0
+    sequence = args.sequence
+    if args.update:
+        # update goes to the other sector with the next sequence number and only that sector is flashed,
+        # so device falls back to current record in case flashing is interrupted
+        with open(args.update, "rb") as current_file:
+            current = current_file.read()
+        if len(current) != CONFIG_SECTOR_SIZE * CONFIG_SECTORS_COUNT:
+            gen_routes.fail("%s is not a config image read from flash (%d bytes)" % (args.update, len(current)))
+        active = find_active_sector(current)
+        if active:
+            sector = active[0] ^ 1
+            sequence = (active[1] + 1) & 0xFFFFFFFF
+    crc = zlib.crc32(body) & 0xFFFFFFFF
+    record = struct.pack("<IHHII", CONFIG_MAGIC, CONFIG_VERSION, size, sequence, crc) + body
+    image = record + b"\xFF" * (CONFIG_SECTOR_SIZE - len(record))
+    if not args.update:
+        # fresh image - record is placed into the first sector, the second one is erased
+        image += b"\xFF" * (CONFIG_SECTOR_SIZE * (CONFIG_SECTORS_COUNT - 1))
+    address = CONFIG_PARTITION_ADDR + sector * CONFIG_SECTOR_SIZE
+    with open(args.output, "wb") as output_file:
+        output_file.write(image)
+    with open(args.output + ".addr", "w") as address_file:
+        address_file.write("0x%06X\n" % address)
+    print("[INFO] %d bytes config record (%d routes, %d queries, sequence %d) written to %s, flash it at 0x%06X" %
+          (size, len(routes), len(plan), sequence, args.output, address))
+
+
+def decode_string(data):
+    return data.split(b"\0", 1)[0].decode("utf-8", "replace")
+
+
+def decode_sector(sector, data):
+    header = struct.unpack_from(HEADER_FORMAT, data)
+    magic, version, size, sequence, crc = header[:5]
+    if magic != CONFIG_MAGIC:
+        print("sector %d: empty" % sector)
+        return
+    if version != CONFIG_VERSION or not RECORD_SIZE <= size <= CONFIG_SECTOR_SIZE:
+        print("sector %d: unsupported record (version %d, size %d)" % (sector, version, size))
+        return
+    actual_crc = zlib.crc32(data[CRC_OFFSET:size]) & 0xFFFFFFFF
+    print("sector %d: sequence %d, %d bytes, CRC %08X (%s)" %
+          (sector, sequence, size, crc, "valid" if crc == actual_crc else "INVALID, actual %08X" % actual_crc))
+    ssid, passphrase, key, routes_count, queries_count = header[5:10]
+    print("  wifi ssid:  %s" % decode_string(ssid))
+    print("  passphrase: %s" % ("*" * len(decode_string(passphrase))))
+    print("  api key:    %s" % decode_string(key))
+    offset = struct.calcsize(HEADER_FORMAT)
+    for i in range(min(routes_count, CONFIG_MAX_ROUTES)):
+        best_time, worst_time, query_idx, origin_idx, destination_idx, _ = \
+            struct.unpack_from(ROUTE_FORMAT, data, offset + i * struct.calcsize(ROUTE_FORMAT))
+        print("  route %d: best %d sec, worst %d sec, query %d (origin %d, destination %d)" %
+              (i, best_time, worst_time, query_idx, origin_idx, destination_idx))
+    offset += CONFIG_MAX_ROUTES * struct.calcsize(ROUTE_FORMAT)
+    for i in range(min(queries_count, CONFIG_MAX_QUERIES)):
+        url_offset, url_len, query_type, route_idx, leg_idx, _ = \
+            struct.unpack_from(QUERY_FORMAT, data, offset + i * struct.calcsize(QUERY_FORMAT))
+        url = data[url_offset:url_offset + url_len].decode("ascii", "replace")
+        print("  query %d (%s, route %s, leg %d): %s" %
+              (i, "distance matrix" if query_type else "directions",
+               "batch" if route_idx == ROUTE_QUERY_BATCH else route_idx, leg_idx, url))
+
+
+def decode(args):
+    with open(args.image, "rb") as image_file:
+        image = image_file.read()
+    for sector in range(min(len(image) // CONFIG_SECTOR_SIZE, CONFIG_SECTORS_COUNT)):
+        decode_sector(sector, image[sector * CONFIG_SECTOR_SIZE:(sector + 1) * CONFIG_SECTOR_SIZE])
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Runtime configuration flash image encoder / decoder")
+    commands = parser.add_subparsers(dest="command")
+    encode_parser = commands.add_parser("encode")
+    encode_parser.add_argument("routes")
+    encode_parser.add_argument("output")
+    encode_parser.add_argument("--ssid", required=True)
+    encode_parser.add_argument("--passphrase", required=True)
+    encode_parser.add_argument("--key", required=True)
+    encode_parser.add_argument("--sequence", type=int, default=1)
+    encode_parser.add_argument("--update", metavar="CURRENT",
+                               help="config sectors read from flash - only their inactive sector is written")
+    decode_parser = commands.add_parser("decode")
+    decode_parser.add_argument("image")
+    args = parser.parse_args()
+    if args.command == "encode":
+        encode(args)
+    elif args.command == "decode":
+        decode(args)
+    else:
+        parser.print_help()
+        sys.exit(1)
+
+
+if __name__ == "__main__":
+    main()
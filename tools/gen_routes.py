@@ -0,0 +1,250 @@
+#!/usr/bin/env python3
+# Generates route tables with precomposed request URLs (include/routes_gen.h) from route description file.
+# Usage: gen_routes.py [--check] config/routes.json include/routes_gen.h
+#   --check - only verifies that existing header matches route file (used by firmware build)
+
+import json
+import os
+import re
+import sys
+
+DIRECTIONS_API_BASE_URL = "https://maps.googleapis.com/maps/api/directions/json?"
+DISTANCE_MATRIX_API_BASE_URL = "https://maps.googleapis.com/maps/api/distancematrix/json?"
+API_TIME = "departure_time=now"
+INCLUDE_DIR = os.path.join(os.path.dirname(os.path.abspath(__file__)), "..", "include")
+
+
+def read_define(header, name):
+    # limits are taken from firmware headers, so generator cannot accept what firmware buffers cannot hold
+    with open(os.path.join(INCLUDE_DIR, header)) as header_file:
+        match = re.search(r"^#define\s+%s\s+(\d+)\s*$" % name, header_file.read(), re.MULTILINE)
+    if not match:
+        sys.stderr.write("[ERROR] %s is not defined in include/%s\n" % (name, header))
+        sys.exit(1)
+    return int(match.group(1))
+
+
+# request URL (with API key) is loaded into buffer of this size, its path is kept in buffer of the same size
+HTTP_URL_BUFFER_SIZE = read_define("mod_http.h", "HTTP_URL_BUFFER_SIZE")
+HTTP_HEADER_BUFFER_SIZE = read_define("mod_http.h", "HTTP_HEADER_BUFFER_SIZE")
+# Google API keys are 39 characters long
+API_KEY_LENGTH = 39
+MAX_ROUTES = 0xFE
+ROUTE_MAX_LEGS = read_define("mod_routes.h", "ROUTE_MAX_LEGS")
+
+
+def read_static_const(source, name):
+    # daily request budget is static const of firmware source, plan whose single update exhausts it is rejected
+    with open(os.path.join(INCLUDE_DIR, "..", source)) as source_file:
+        match = re.search(r"^static const \w+ %s\s*=\s*(\d+);" % name, source_file.read(), re.MULTILINE)
+    if not match:
+        sys.stderr.write("[ERROR] %s is not defined in %s\n" % (name, source))
+        sys.exit(1)
+    return int(match.group(1))
+
+
+POLL_DAILY_BUDGET = read_static_const(os.path.join("user", "user_main.c"), "POLL_DAILY_BUDGET")
+
+
+def fail(message):
+    sys.stderr.write("[ERROR] %s\n" % message)
+    sys.exit(1)
+
+
+def format_coords(coords):
+    # 6 decimal places (~0.1 m), comma is URL-encoded
+    return "%.6f%%2C%.6f" % (coords[0], coords[1])
+
+
+def parse_coords(value, name):
+    if not isinstance(value, list) or len(value) != 2:
+        fail("%s has to be [lat, lng] pair" % name)
+    lat, lng = float(value[0]), float(value[1])
+    if not -90.0 <= lat <= 90.0 or not -180.0 <= lng <= 180.0:
+        fail("%s is out of range: %s" % (name, value))
+    return (round(lat, 6), round(lng, 6))
+
+
+def load_routes(path):
+    with open(path) as config_file:
+        config = json.load(config_file)
+    key = config.get("key", "HTTP_QUERY_KEY")
+    if not key.isidentifier():
+        fail("key has to reference C macro name, got `%s`" % key)
+    routes = []
+    for idx, item in enumerate(config.get("routes", [])):
+        name = "route %d" % idx
+        route = {
+            "start": parse_coords(item.get("start"), name + " start"),
+            "end": parse_coords(item.get("end"), name + " end"),
+            "waypoints": [parse_coords(w, "%s waypoint %d" % (name, i)) for i, w in enumerate(item.get("waypoints", []))],
+            "best_time": int(item.get("best_time", 0)),
+            "worst_time": int(item.get("worst_time", 0)),
+        }
+        if not 0 < route["best_time"] < route["worst_time"]:
+            fail("%s: best_time has to be positive and less than worst_time" % name)
+        # optional per-leg thresholds - route is split at its waypoints into waypoints + 1 legs
+        route["legs"] = []
+        for leg_idx, leg in enumerate(item.get("legs", [])):
+            leg = {"best_time": int(leg.get("best_time", 0)), "worst_time": int(leg.get("worst_time", 0))}
+            if not 0 < leg["best_time"] < leg["worst_time"]:
+                fail("%s leg %d: best_time has to be positive and less than worst_time" % (name, leg_idx))
+            route["legs"].append(leg)
+        if route["legs"] and len(route["legs"]) != len(route["waypoints"]) + 1:
+            fail("%s: %d legs defined, route with %d waypoints has %d legs" %
+                 (name, len(route["legs"]), len(route["waypoints"]), len(route["waypoints"]) + 1))
+        if len(route["legs"]) > ROUTE_MAX_LEGS:
+            fail("%s: too many legs (%d, max %d)" % (name, len(route["legs"]), ROUTE_MAX_LEGS))
+        routes.append(route)
+    if not routes:
+        fail("no routes defined")
+    if len(routes) > MAX_ROUTES:
+        fail("too many routes (%d)" % len(routes))
+    return key, routes
+
+
+# Routes without waypoints are batched into a single Distance Matrix request (with unique origins / destinations),
+# routes with legs are queried with single-element Distance Matrix request per leg (Directions API does not report
+# traffic times of stopover legs; one request for all legs would be billed for legs x legs elements), route refers
+# to its last leg query, other routes with waypoints are queried with Directions API one by one. Distance Matrix
+# request is billed per element (origins x destinations), so each query carries its billed elements count
+def build_query_plan(routes):
+    batched = [i for i, route in enumerate(routes) if not route["waypoints"] and not route["legs"]]
+    if len(batched) < 2:
+        batched = []
+    plan = []
+    if batched:
+        origins = []
+        destinations = []
+        for i in batched:
+            route = routes[i]
+            if route["start"] not in origins:
+                origins.append(route["start"])
+            if route["end"] not in destinations:
+                destinations.append(route["end"])
+            route["query_idx"] = 0
+            route["origin_idx"] = origins.index(route["start"])
+            route["destination_idx"] = destinations.index(route["end"])
+        url = (DISTANCE_MATRIX_API_BASE_URL +
+               "origins=" + "%7C".join(format_coords(c) for c in origins) +
+               "&destinations=" + "%7C".join(format_coords(c) for c in destinations))
+        plan.append({"type": "ROUTE_QUERY_DISTANCE_MATRIX", "route_idx": "ROUTE_QUERY_BATCH", "leg_idx": 0, "url": url,
+                     "elements": len(origins) * len(destinations),
+                     "comment": "Distance Matrix: routes %s (%d origins, %d destinations)" %
+                                (", ".join(str(i) for i in batched), len(origins), len(destinations))})
+    for i, route in enumerate(routes):
+        if i in batched:
+            continue
+        route["origin_idx"] = 0
+        route["destination_idx"] = 0
+        if route["legs"]:
+            points = [route["start"]] + route["waypoints"] + [route["end"]]
+            for leg_idx in range(len(route["legs"])):
+                url = (DISTANCE_MATRIX_API_BASE_URL + "origins=" + format_coords(points[leg_idx]) +
+                       "&destinations=" + format_coords(points[leg_idx + 1]))
+                plan.append({"type": "ROUTE_QUERY_DISTANCE_MATRIX", "route_idx": str(i), "leg_idx": leg_idx,
+                             "url": url, "elements": 1,
+                             "comment": "Distance Matrix: route %d leg %d of %d" % (i, leg_idx, len(route["legs"]))})
+            route["query_idx"] = len(plan) - 1
+            continue
+        route["query_idx"] = len(plan)
+        url = DIRECTIONS_API_BASE_URL + "origin=" + format_coords(route["start"])
+        if route["waypoints"]:
+            url += "&waypoints=" + "%7C".join("via%3A" + format_coords(w) for w in route["waypoints"])
+        url += "&destination=" + format_coords(route["end"])
+        plan.append({"type": "ROUTE_QUERY_DIRECTIONS", "route_idx": str(i), "leg_idx": 0, "url": url, "elements": 1,
+                     "comment": "Directions: route %d (%d waypoints)" % (i, len(route["waypoints"]))})
+    for query in plan:
+        query["url"] += "&" + API_TIME + "&key="
+        if len(query["url"]) + API_KEY_LENGTH >= HTTP_URL_BUFFER_SIZE:
+            fail("request URL with API key exceeds HTTP_URL_BUFFER_SIZE (%d bytes): %s" % (HTTP_URL_BUFFER_SIZE, query["url"]))
+        hostname = query["url"].split("://", 1)[-1].split("/", 1)[0]
+        if len(hostname) >= HTTP_HEADER_BUFFER_SIZE:
+            fail("request hostname exceeds HTTP_HEADER_BUFFER_SIZE: %s" % hostname)
+    elements = sum(query["elements"] for query in plan)
+    if elements >= POLL_DAILY_BUDGET:
+        fail("single update is billed for %d requests, it exhausts POLL_DAILY_BUDGET (%d)" % (elements, POLL_DAILY_BUDGET))
+    return plan
+
+
+def generate(key, routes, plan, source_path):
+    lines = [
+        "// Generated by tools/gen_routes.py from %s - do not edit, run `make routes` instead" % source_path,
+        "#ifndef INCLUDE_ROUTES_GEN_H_",
+        "#define INCLUDE_ROUTES_GEN_H_",
+        "",
+        "#include \"mod_routes.h\"",
+        "",
+        "#ifndef %s" % key,
+        "#error \"%s has to be defined before routes_gen.h is included\"" % key,
+        "#endif",
+        "",
+        "#define ROUTE_COUNT                             %d" % len(routes),
+        "#define QUERY_PLAN_SIZE                         %d" % len(plan),
+        "// billed requests per update (Distance Matrix elements, Directions requests)",
+        "#define QUERY_PLAN_ELEMENTS                     %d" % sum(query["elements"] for query in plan),
+        "#define ROUTE_LEGS_COUNT                        %d" % sum(len(route["legs"]) for route in routes),
+        "",
+    ]
+    for idx, query in enumerate(plan):
+        lines.append("// %s" % query["comment"])
+        lines.append("static const char ROUTE_QUERY_%d_URL[] ICACHE_RODATA_ATTR STORE_ATTR =" % idx)
+        lines.append("\t\t\"%s\" %s;" % (query["url"], key))
+    lines.append("")
+    lines.append("static const struct route_query QUERY_PLAN[QUERY_PLAN_SIZE] =")
+    lines.append("{")
+    for idx, query in enumerate(plan):
+        lines.append("\t\t{ ROUTE_QUERY_%d_URL, sizeof(ROUTE_QUERY_%d_URL) - 1, %s, %s, %d, %d }%s" %
+                     (idx, idx, query["type"], query["route_idx"], query["leg_idx"], query["elements"],
+                      "," if idx + 1 < len(plan) else ""))
+    lines.append("};")
+    lines.append("")
+    legs = [leg for route in routes for leg in route["legs"]]
+    lines.append("// { best time, worst time } of route legs (a single unused entry if no route defines legs)")
+    lines.append("static const struct route_leg ROUTE_LEGS[%s] =" % ("ROUTE_LEGS_COUNT" if legs else "1"))
+    lines.append("{")
+    for idx, leg in enumerate(legs or [{"best_time": 0, "worst_time": 0}]):
+        lines.append("\t\t{ %d, %d }%s" % (leg["best_time"], leg["worst_time"], "," if idx + 1 < max(len(legs), 1) else ""))
+    lines.append("};")
+    lines.append("")
+    lines.append("// { best time, worst time, query index, origin index, destination index, legs count, first leg index }")
+    lines.append("static const struct route_info ROUTES[ROUTE_COUNT] =")
+    lines.append("{")
+    first_leg_idx = 0
+    for idx, route in enumerate(routes):
+        lines.append("\t\t{ %d, %d, %d, %d, %d, %d, %d }%s" %
+                     (route["best_time"], route["worst_time"], route["query_idx"], route["origin_idx"],
+                      route["destination_idx"], len(route["legs"]), first_leg_idx, "," if idx + 1 < len(routes) else ""))
+        first_leg_idx += len(route["legs"])
+    lines.append("};")
+    lines.append("")
+    lines.append("#endif /* INCLUDE_ROUTES_GEN_H_ */")
+    return "\n".join(lines) + "\n"
+
+
+def main():
+    args = sys.argv[1:]
+    is_check = args[:1] == ["--check"]
+    if is_check:
+        args = args[1:]
+    if len(args) != 2:
+        fail("usage: gen_routes.py [--check] <routes.json> <output header>")
+    key, routes = load_routes(args[0])
+    plan = build_query_plan(routes)
+    content = generate(key, routes, plan, args[0])
+    if is_check:
+        existing = None
+        if os.path.exists(args[1]):
+            with open(args[1]) as header_file:
+                existing = header_file.read()
+        if existing != content:
+            fail("%s does not match %s, run `make routes`" % (args[1], args[0]))
+        return
+    with open(args[1], "w") as output_file:
+        output_file.write(content)
+    print("[INFO] %d routes, %d queries (%d billed requests) per update written to %s" %
+          (len(routes), len(plan), sum(query["elements"] for query in plan), args[1]))
+
+
+if __name__ == "__main__":
+    main()
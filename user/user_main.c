@@ -4,10 +4,26 @@
 #include <gpio.h>
 #include <espconn.h>
 #include <sntp.h>
-#include <json/jsonparse.h>
 
 #include "mod_enums.h"
 #include "mod_http.h"
+#include "mod_http_client.h"
+#include "mod_json.h"
+#include "mod_arena.h"
+#include "mod_dns.h"
+#include "mod_inflate.h"
+#include "mod_poll.h"
+#include "mod_sched.h"
+#include "mod_display.h"
+#include "mod_effects.h"
+#include "mod_routes.h"
+#include "mod_config.h"
+#include "mod_rtcmem.h"
+#include "mod_metrics.h"
+#include "mod_status.h"
+#include "mod_trend.h"
+#include "mod_station.h"
+#include "mod_clock.h"
 
 // Update according to WiFi session ID
 #define WIFI_SSID								"[WIFI-SESSION-ID]"
@@ -16,24 +32,54 @@
 // Directions API Key
 #define HTTP_QUERY_KEY							"[GOOGLE-DIRECTIONS-API-KEY]"
 
-// Directions API tags
-#define DIRECTIONS_API_BASE_URL					"https://maps.googleapis.com/maps/api/directions/json?"
-#define DIRECTIONS_API_TAG_START				"origin"
-#define DIRECTIONS_API_TAG_END					"destination"
-#define DIRECTIONS_API_TAG_WAYPOINTS			"waypoints"
-#define DIRECTIONS_API_TAG_VIA					"via"
-#define DIRECTIONS_API_TAG_KEY					"key"
-#define DIRECTIONS_API_TIME						"departure_time=now"
-
-// JSON section name to extract
-#define JSON_TAG_DURATION						"duration_in_traffic"
-// JSON value tag name to extract
-#define JSON_TAG_NESTED_VALUE					"value"
-// JSON tag depth level to extract
-#define JSON_DEPTH_NESTED_VALUE					1
+// Monitored routes and precomposed request URLs (generated from config/routes.json by `make routes`)
+#include "routes_gen.h"
+
+// Fields extracted from Directions API response in a single pass (route values are summed over all route legs)
+struct route_fields
+{
+	sint32 duration_in_traffic;
+	sint32 duration;
+	sint32 distance;
+	char summary[JSON_STREAM_TOKEN_SIZE];
+	char status[16];
+};
+
+JSON_PATH_DECLARE(JSON_PATH_STATUS, JSON_KEY("status"));
+JSON_PATH_DECLARE(JSON_PATH_SUMMARY, JSON_KEY("routes"), JSON_INDEX(0), JSON_KEY("summary"));
+JSON_PATH_DECLARE(JSON_PATH_DURATION, JSON_KEY("routes"), JSON_INDEX(0), JSON_KEY("legs"), JSON_ANY_INDEX,
+		JSON_KEY("duration_in_traffic"), JSON_KEY("value"));
+JSON_PATH_DECLARE(JSON_PATH_FREE_FLOW_DURATION, JSON_KEY("routes"), JSON_INDEX(0), JSON_KEY("legs"), JSON_ANY_INDEX,
+		JSON_KEY("duration"), JSON_KEY("value"));
+JSON_PATH_DECLARE(JSON_PATH_DISTANCE, JSON_KEY("routes"), JSON_INDEX(0), JSON_KEY("legs"), JSON_ANY_INDEX,
+		JSON_KEY("distance"), JSON_KEY("value"));
+// route time value in Distance Matrix response (indices: origin, destination)
+JSON_PATH_DECLARE(JSON_PATH_MATRIX_DURATION, JSON_KEY("rows"), JSON_ANY_INDEX, JSON_KEY("elements"), JSON_ANY_INDEX,
+		JSON_KEY("duration_in_traffic"), JSON_KEY("value"));
+
+#define JSON_FIELD_IDX_STATUS					0
+#define JSON_FIELD_IDX_DURATION					1
+#define JSON_FIELD_IDX_MATRIX_DURATION			1
+
+static const struct json_field JSON_DIRECTIONS_FIELDS[] =
+{
+		JSON_FIELD(JSON_PATH_STATUS, JSON_FIELD_STRING, struct route_fields, status),
+		JSON_FIELD(JSON_PATH_DURATION, JSON_FIELD_NUMBER_SUM, struct route_fields, duration_in_traffic),
+		JSON_FIELD(JSON_PATH_FREE_FLOW_DURATION, JSON_FIELD_NUMBER_SUM, struct route_fields, duration),
+		JSON_FIELD(JSON_PATH_DISTANCE, JSON_FIELD_NUMBER_SUM, struct route_fields, distance),
+		JSON_FIELD(JSON_PATH_SUMMARY, JSON_FIELD_STRING, struct route_fields, summary)
+};
+
+// Distance Matrix route times are handled per element (origin / destination indices) by value callback
+static const struct json_field JSON_MATRIX_FIELDS[] =
+{
+		JSON_FIELD(JSON_PATH_STATUS, JSON_FIELD_STRING, struct route_fields, status),
+		JSON_FIELD_NOTIFY_DECLARE(JSON_PATH_MATRIX_DURATION)
+};
 
 #define UART_BAUD_RATE							115200
 #define LABEL_BUFFER_SIZE						128
+// number of LEDs on the bar (8 per daisy-chained 74HC595 register, up to DISPLAY_MAX_LEDS)
 #define LED_COUNT								8
 
 #define SYSTEM_PARTITION_RF_CAL_SZ				0x1000
@@ -43,143 +89,380 @@
 #define SYSTEM_PARTITION_RF_CAL_ADDR			0x3FB000
 #define SYSTEM_PARTITION_PHY_DATA_ADDR			0x3FC000
 #define SYSTEM_PARTITION_SYSTEM_PARAMETER_ADDR	0x3FE000
-
-struct gps_coords
-{
-	double lat;
-	double lng;
-};
-
-// route start GPS position
-static const struct gps_coords START_POSITION 	= { 51.564418, -0.062658 };
-// route end GPS position
-static const struct gps_coords END_POSITION 	= { 51.519986, -0.082895 };
-// intermediate waypoint GPS positions
-static const struct gps_coords WAYPOINTS[]		=
-{
-		{ 51.556724, -0.074518 },
-		{ 51.531606, -0.077044 }
-};
-// defines worst time on the route (in seconds) - all warning LEDs will be ignited - means traffic jam
-static const sint32 WORST_ROUTE_TIME = 1600;
-// defines best time on the route (in seconds) - all warning LEDs will be off - means road is free
-static const sint32 BEST_ROUTE_TIME = 960;
+// runtime configuration record (two sectors right below RF calibration data)
+#define CONFIG_PARTITION_SZ						(CONFIG_SECTOR_SIZE * CONFIG_SECTORS_COUNT)
+#define CONFIG_PARTITION_ADDR					0x3F9000
+
+// LED bar shows routes one by one (cycling) or side by side (each route gets LED_COUNT / ROUTE_COUNT LEDs),
+// or one by one with route legs side by side (each leg of route with legs gets LED_COUNT / legs count LEDs)
+#define ROUTE_DISPLAY_CYCLE						0
+#define ROUTE_DISPLAY_SPLIT						1
+#define ROUTE_DISPLAY_LEGS						2
+static const uint8 ROUTE_DISPLAY_MODE			= ROUTE_DISPLAY_CYCLE;
+
+// Route time trend between queries: not shown, shown as blinking marker on top of measured level
+// (LED above the level for rising time, top LED of the level for falling time), or level predicted
+// from trend is shown and updated every TIMER_PERIOD_TREND
+#define TREND_DISPLAY_NONE						0
+#define TREND_DISPLAY_INDICATOR					1
+#define TREND_DISPLAY_PREDICTION				2
+static const uint8 TREND_DISPLAY_MODE			= TREND_DISPLAY_INDICATOR;
+
+// LED effects: { operation, argument, duration (ms) } steps
+// status LED - short flash every 2 sec while WiFi is connected, constantly on if query has failed
+EFFECT_DECLARE(EFFECT_HEARTBEAT, true, { EFFECT_OP_STATUS, 1, 10 }, { EFFECT_OP_STATUS, 0, 1990 });
+EFFECT_DECLARE(EFFECT_STATUS_ERROR, false, { EFFECT_OP_STATUS, 1, 0 });
+EFFECT_DECLARE(EFFECT_STATUS_OFF, false, { EFFECT_OP_STATUS, 0, 0 });
+// status LED - double flash while levels restored after reset are shown (not refreshed yet)
+EFFECT_DECLARE(EFFECT_STATUS_STALE, true, { EFFECT_OP_STATUS, 1, 10 }, { EFFECT_OP_STATUS, 0, 150 },
+		{ EFFECT_OP_STATUS, 1, 10 }, { EFFECT_OP_STATUS, 0, 1830 });
+// LED bar - route levels (changed one LED per 40 ms), last LED blinking while there is no data yet,
+// halves of the bar alternating while there is no data because of query errors
+EFFECT_DECLARE(EFFECT_LEVELS, false, { EFFECT_OP_BAR_LEVELS, 0, 40 });
+// LED bar - route levels with trend markers blinking once per second
+EFFECT_DECLARE(EFFECT_LEVELS_TREND, true, { EFFECT_OP_BAR_LEVELS, 0, 40 }, { EFFECT_OP_BAR_MARKERS, 0, 460 },
+		{ EFFECT_OP_BAR_MARKERS, 1, 500 });
+EFFECT_DECLARE(EFFECT_BLANK, true, { EFFECT_OP_BAR_CLEAR, 0, 1000 }, { EFFECT_OP_BAR_LED, 0, 1000 });
+EFFECT_DECLARE(EFFECT_BAR_ERROR, true, { EFFECT_OP_BAR_PATTERN, 0x0F, 500 }, { EFFECT_OP_BAR_PATTERN, 0xF0, 500 });
+
+#if LED_COUNT > DISPLAY_MAX_LEDS
+#error "LED_COUNT exceeds DISPLAY_MAX_LEDS"
+#endif
 
 static const uint16 GPIO_PIN_LED		= 2;
 static const uint16 GPIO_PIN_SER_DATA	= 4;
 static const uint16 GPIO_PIN_SER_CLOCK	= 5;
 static const uint16 GPIO_PIN_READ_LATCH	= 12;
 
-static const uint16 DELAY_HEARTBEAT_FLASH		= 10 * 1000;
-static const uint16 DELAY_SHIFT_REG				= 50;
-
-// PERIOD UNITS 								x10ms
-static const uint32 TIMER_PERIOD_LED			= 200;		// 2 sec
-static const uint32 TIMER_PERIOD_BLANK_LED		= 100;		// 1 sec
-static const uint32 TIMER_PERIOD_CONN			= 1000;		// 10 sec
-static const uint32 TIMER_PERIOD_CONN_RETRY		= 12000;	// 2 mins
-static const uint32 TIMER_PERIOD_CLOSE_SOCKET	= 10;		// 100 ms
-static const uint32 TIMER_PERIOD_QUERY			= 60000;    // 10 min
-static const uint32 TIMER_PERIOD_INITIAL_QUERY	= 6000;    	// 1 min
-static const uint32 TIMER_IDX_RESET				= 200000000L;
-
-static os_timer_t start_timer;
-static uint32 tick_index = 0L;
-static sint32 retry_tick_index = -1;
-static sint32 duration_value = -1;
-
-// index - used for cursor position tracking at receive buffer
-static size_t local_http_receive_idx = 0;
-// used to resolve target hostname ip address by DNS
-static ip_addr_t target_server_ip;
-// composed URL to query
-static char complete_url[HTTP_URL_BUFFER_SIZE];
-// used to store url prefix type (HTTP or HTTPS)
-static int url_prefix_type = HTTP_URL_HTTP;
-// used to store http hostname
-static char http_hostname[HTTP_HEADER_BUFFER_SIZE];
-// used to store http path
-static char http_path[HTTP_HEADER_BUFFER_SIZE];
-// used to indicate whether HTTP data transfer has started
-static bool is_transfer_started = false;
+// Shift registers are driven by HSPI peripheral (data - GPIO13, clock - GPIO14) when building
+// with UNIVERSAL_TARGET_DEFINES=-DDISPLAY_HSPI, otherwise by direct GPIO register writes
+#ifdef DISPLAY_HSPI
+static const uint8 DISPLAY_DRIVER				= DISPLAY_DRIVER_HSPI;
+#else
+static const uint8 DISPLAY_DRIVER				= DISPLAY_DRIVER_GPIO;
+#endif
+
+// PERIOD UNITS 								ms
+static const uint32 TIMER_PERIOD_STATUS			= 2000;		// 2 sec
+static const uint32 TIMER_PERIOD_CONN			= 10000;	// 10 sec
+static const uint32 TIMER_PERIOD_CONN_RETRY		= 120000;	// 2 mins
+static const uint32 TIMER_PERIOD_INITIAL_QUERY	= 60000;   	// 1 min
+static const uint32 TIMER_PERIOD_ROUTE_CYCLE	= 5000;		// 5 sec
+static const uint32 TIMER_PERIOD_SLEEP			= 200;		// 200 ms
+static const uint32 TIMER_PERIOD_TREND			= 60000;	// 1 min
+static const uint32 TIMER_PERIOD_CLOCK			= 60000;	// 1 min
+static const uint32 TIMER_PERIOD_CLOCK_WAIT		= 1000;		// 1 sec
+
+// Adaptive polling: interval limits (seconds) and daily budget of billed requests (Distance Matrix elements / Directions requests)
+static const uint16 POLL_INTERVAL_MIN			= 120;		// 2 min
+static const uint16 POLL_INTERVAL_MAX			= 1800;		// 30 min
+static const uint16 POLL_DAILY_BUDGET			= 300;
+// Local time zone offset (hours) - used for time-of-day polling windows
+static const sint8 TIMEZONE_OFFSET				= 0;
+// Time-of-day windows: { start minute, end minute, min interval, max interval }
+static const struct poll_window POLL_WINDOWS[]	=
+{
+		{ 23 * 60, 5 * 60, 1800, 3600 },	// night - rare updates
+		{ 7 * 60, 10 * 60, 120, 600 },		// morning rush hour
+		{ 16 * 60, 19 * 60, 120, 600 }		// evening rush hour
+};
+
+// Parallel connections of HTTP client (further requests are queued, TLS connections are limited to one by SDK)
+static const uint8 HTTP_PARALLEL_CONNECTIONS	= 2;
+
+// Keeps (TLS) connection open between queries to avoid repeated handshakes - enabled by
+// building with UNIVERSAL_TARGET_DEFINES=-DHTTP_KEEP_ALIVE. Falls back to a full handshake
+// whenever server closes the connection or reused connection fails before responding
+#ifdef HTTP_KEEP_ALIVE
+static const bool KEEP_ALIVE_MODE				= true;
+#else
+static const bool KEEP_ALIVE_MODE				= false;
+#endif
+
+// Requests gzip-compressed responses (Accept-Encoding: gzip) - enabled by building with
+// UNIVERSAL_TARGET_DEFINES=-DHTTP_GZIP. Response body is inflated on the fly into heap-allocated
+// history window sized to free heap (at least INFLATE_WINDOW_BITS), identity encoding is requested instead while
+// not even the smallest window fits, and for the next query once response refers beyond the window
+#ifdef HTTP_GZIP
+static const bool GZIP_MODE						= true;
+#else
+static const bool GZIP_MODE						= false;
+#endif
+
+// Lets SDK enter light sleep between scheduled tasks (WiFi stays associated, woken up by
+// DTIM beacons and timers) - enabled by building with UNIVERSAL_TARGET_DEFINES=-DLIGHT_SLEEP
+#ifdef LIGHT_SLEEP
+static const bool LIGHT_SLEEP_MODE				= true;
+#else
+static const bool LIGHT_SLEEP_MODE				= false;
+#endif
+
+// Deep sleep duty cycle: after each completed update levels stay latched in 74HC595 registers while ESP sleeps
+// until the next update (GPIO16 needs to be wired to RST) - enabled by building with UNIVERSAL_TARGET_DEFINES=-DDEEP_SLEEP
+#ifdef DEEP_SLEEP
+static const bool DEEP_SLEEP_MODE				= true;
+#else
+static const bool DEEP_SLEEP_MODE				= false;
+#endif
+// RF calibration is skipped upon wake-up (shorter wake-to-display time)
+#define DEEP_SLEEP_RF_OPTION					2
+// current consumption used for energy estimate: awake with WiFi (mA) and deep sleep (uA, without LEDs)
+static const uint32 DEEP_SLEEP_ACTIVE_CURRENT	= 70;
+static const uint32 DEEP_SLEEP_SLEEP_CURRENT	= 20;
+// failed update (DNS, connection, no WiFi within DEEP_SLEEP_CONNECT_TIMEOUT ms since wake-up) is re-tried after this sleep (seconds)
+static const uint32 DEEP_SLEEP_RETRY_INTERVAL	= 300;		// 5 min
+static const uint32 DEEP_SLEEP_CONNECT_TIMEOUT	= 30000;	// 30 sec
+// sleep longer than SDK maximum is split - shorter rest of planned sleep (seconds) is waited awake after wake-up
+static const uint32 DEEP_SLEEP_MIN_DURATION		= 60;		// 1 min
+
+// Device status served as JSON over HTTP on STATUS_SERVER_PORT (station interface) - enabled by building
+// with UNIVERSAL_TARGET_DEFINES=-DSTATUS_SERVER
+#ifdef STATUS_SERVER
+static const bool STATUS_SERVER_MODE			= true;
+#else
+static const bool STATUS_SERVER_MODE			= false;
+#endif
+// status document parts - worst-case size is derived from formats, each number takes at most 11 characters ("-2147483648")
+#define STATUS_HEAD_FORMAT						"{\"uptime\":%d,\"free_heap\":%d,\"wifi\":%d,\"wifi_connect_ms\":%d,\"wifi_fast\":%d," \
+												"\"wifi_fallbacks\":%d,\"clock\":%d,\"query_error\":%d,\"empty\":%d,\"restored\":%d," \
+												"\"last_update_age\":%d,\"next_update\":%d,\"routes\":["
+#define STATUS_HEAD_FIELDS						12
+#define STATUS_ROUTE_FORMAT						"%s{\"duration\":%d,\"level\":%d,\"slope\":%d}"
+#define STATUS_ROUTE_FIELDS						3
+#define STATUS_METRICS_FORMAT					"],\"queries\":%d,\"failures\":%d,\"query_avg_ms\":%d,\"query_max_ms\":%d,\"min_free_heap\":%d}"
+#define STATUS_METRICS_FIELDS					5
+#define STATUS_TAIL_FORMAT						"]}"
+#define STATUS_NUMBER_SIZE						11
+// format length with each "%d" replaced by the longest number
+#define STATUS_FORMAT_SIZE(format, fields)		(sizeof(format) - 1 + (fields) * (STATUS_NUMBER_SIZE - 2))
+#ifdef QUERY_METRICS
+#define STATUS_FIXED_SIZE						(STATUS_FORMAT_SIZE(STATUS_HEAD_FORMAT, STATUS_HEAD_FIELDS) + STATUS_FORMAT_SIZE(STATUS_METRICS_FORMAT, STATUS_METRICS_FIELDS))
+#else
+#define STATUS_FIXED_SIZE						(STATUS_FORMAT_SIZE(STATUS_HEAD_FORMAT, STATUS_HEAD_FIELDS) + STATUS_FORMAT_SIZE(STATUS_TAIL_FORMAT, 0))
+#endif
+// route separator ("%s") takes a single character
+#define STATUS_ROUTE_SIZE						(STATUS_FORMAT_SIZE(STATUS_ROUTE_FORMAT, STATUS_ROUTE_FIELDS) - 1)
+
+static struct poll_config poll_config;
+// largest route time change observed within current update
+static uint32 update_change = 0;
+// used to indicate that query is re-tried after connection failure
+static bool is_retry_pending = false;
+
+// scheduled tasks (application main loop)
+static sint8 conn_task = SCHED_INVALID_TASK;
+static sint8 status_task = SCHED_INVALID_TASK;
+static sint8 route_cycle_task = SCHED_INVALID_TASK;
+static sint8 initial_query_task = SCHED_INVALID_TASK;
+static sint8 query_task = SCHED_INVALID_TASK;
+static sint8 sleep_task = SCHED_INVALID_TASK;
+static sint8 trend_task = SCHED_INVALID_TASK;
+static sint8 clock_task = SCHED_INVALID_TASK;
+
+// URL to query (loaded from flash-resident QUERY_PLAN)
+static char complete_url[HTTP_URL_BUFFER_SIZE] STORE_ATTR;
+// route query request context (HTTP client keeps connection, response parser and gzip decoder state in it)
+static struct http_request query_request;
 // used to indicate whether HTTP data transfer has failed
 static bool query_error_flag = false;
 // used to indicate whether valid HTTP response data is present
 // (in case of data is missing - indicated as RED blinking LED)
 static bool empty_response_flag = true;
-// used to indicate whether HTTP data transfer has been completed
-static bool is_transfer_completed = false;
-// this buffer is used to persist HTTP content
-static char* http_content = NULL;
-// actual connection definition used to perform HTTP GET request
-struct espconn* pespconn = NULL;
+// streaming JSON tokenizer fed with decoded HTTP body (response is never stored as a whole)
+static struct json_stream json_parser;
+// fields of currently parsed response
+static struct route_fields parsed_fields;
+// route times extracted from JSON response so far
+static sint32 parsed_durations[ROUTE_COUNT];
+// used to indicate whether route time has been found in JSON response
+static bool is_duration_parsed[ROUTE_COUNT];
+// leg times of currently parsed response (route with legs), bit N set - time of leg N has been parsed
+static sint32 parsed_leg_durations[ROUTE_MAX_LEGS];
+static uint8 parsed_legs_mask = 0;
+// latest known route times (-1 if not available)
+static sint32 route_durations[ROUTE_COUNT];
+// latest known leg times of routes with legs (-1 if not available)
+#define LEG_DURATIONS_SIZE						(ROUTE_LEGS_COUNT > 0 ? ROUTE_LEGS_COUNT : 1)
+static sint32 leg_durations[LEG_DURATIONS_SIZE];
+// recent route times and their trends
+static struct trend route_trends[ROUTE_COUNT];
+// used to indicate whether any trend marker is shown on LED bar
+static bool is_trend_shown = false;
+// currently submitted entry of QUERY_PLAN
+static uint8 query_plan_idx = 0;
+// route currently displayed on LED bar (cycling display mode)
+static uint8 displayed_route = 0;
+// route thresholds and query layout (built-in ROUTES, thresholds may be overridden by runtime config)
+static struct route_info route_table[ROUTE_COUNT];
+// used to indicate whether request URLs are read from runtime config rather than built-in QUERY_PLAN
+static bool is_config_routes_active = false;
+
+// Display state kept in RTC memory across resets (lost on power loss)
+struct display_state
+{
+	sint32 route_durations[ROUTE_COUNT];
+	// RTC timer value and its calibrated period (us, Q12 fixed point) upon last update
+	uint32 rtc_time;
+	uint32 rtc_period;
+	// planned delay of the next update (seconds, counted from the last update)
+	uint32 next_update_delay;
+	struct poll_stats poll_stats;
+};
+
+// Display state has to fit into a single RTC memory slot (route durations grow with ROUTE_COUNT)
+ARENA_STATIC_ASSERT(sizeof(struct display_state) <= RTCMEM_SLOT_DATA_SIZE, display_state_size);
+
+// Status document of all routes (with terminating zero) fits into status server buffer
+ARENA_STATIC_ASSERT(STATUS_FIXED_SIZE + ROUTE_COUNT * STATUS_ROUTE_SIZE + 1 <= STATUS_BODY_SIZE, status_size);
+
+// uptime (seconds) of the last successful update (restored updates may lie before boot)
+static sint32 last_update_time = 0;
+static bool is_last_update_known = false;
+// used to indicate whether shown route times are restored from RTC memory and not refreshed yet
+static bool is_state_restored = false;
+// delay of the first query after state is restored (ms)
+static uint32 restored_refresh_delay = 0;
+// used to indicate that refresh of restored state is submitted once WiFi connection is established
+static bool is_refresh_waiting = false;
+// time from boot (wake-up) until restored levels are shown (ms)
+static uint32 wake_to_display_time = 0;
+// deep sleep duration until the next update (seconds)
+static uint32 deep_sleep_duration = 0;
+// used to submit query right away: next query of query plan, or re-submission
+// without compression once compressed response could not be inflated
+static bool pending_query_flag = false;
+
+// Per-query arena budget: TX buffer (response is parsed as it arrives, without arena temporaries)
+ARENA_STATIC_ASSERT(ARENA_ALIGN(HTTP_TX_BUFFER_SIZE) <= ARENA_SIZE, query_budget);
 
 static const partition_item_t part_table[] =
 {
 	{ SYSTEM_PARTITION_RF_CAL,				SYSTEM_PARTITION_RF_CAL_ADDR,			SYSTEM_PARTITION_RF_CAL_SZ				},
 	{ SYSTEM_PARTITION_PHY_DATA,			SYSTEM_PARTITION_PHY_DATA_ADDR,			SYSTEM_PARTITION_PHY_DATA_SZ			},
-	{ SYSTEM_PARTITION_SYSTEM_PARAMETER,	SYSTEM_PARTITION_SYSTEM_PARAMETER_ADDR,	SYSTEM_PARTITION_SYSTEM_PARAMETER_SZ	}
+	{ SYSTEM_PARTITION_SYSTEM_PARAMETER,	SYSTEM_PARTITION_SYSTEM_PARAMETER_ADDR,	SYSTEM_PARTITION_SYSTEM_PARAMETER_SZ	},
+	{ SYSTEM_PARTITION_CUSTOMER_BEGIN,		CONFIG_PARTITION_ADDR,					CONFIG_PARTITION_SZ						}
 };
 
 // ***************************** LED BAR - DISPLAY LEVEL  *****************************
 
-static uint16 calculate_level(sint32 value)
+static uint16 calculate_level(sint32 value, sint32 best_time, sint32 worst_time, uint16 led_count)
 {
 	uint16 result;
-	if (value > WORST_ROUTE_TIME)
+	if (value > worst_time)
 	{
-		result = LED_COUNT;
+		result = led_count;
 	}
-	else if (value < BEST_ROUTE_TIME)
+	else if (value < best_time)
 	{
 		result = 0;
 	}
 	else
 	{
-		result = ((value - BEST_ROUTE_TIME) * LED_COUNT) / (WORST_ROUTE_TIME - BEST_ROUTE_TIME);
+		result = ((value - best_time) * led_count) / (worst_time - best_time);
 	}
 	return result;
 }
 
-static void show_level(uint16 level)
+static uint32 get_uptime_sec(void);
+
+// Route time to display: latest measured one, or the one predicted from trend (prediction display mode)
+static sint32 get_display_duration(uint8 route_idx)
 {
-	OS_UART_LOG("[INFO] Indicating Level: %d\n", level);
-	uint16 i;
-	for (i = 0; i < LED_COUNT; ++i)
+	sint32 duration = route_durations[route_idx];
+	if (TREND_DISPLAY_MODE == TREND_DISPLAY_PREDICTION && duration > 0)
 	{
-		GPIO_OUTPUT_SET(GPIO_PIN_SER_DATA, (i < level));
-		os_delay_us(DELAY_SHIFT_REG);
-		GPIO_OUTPUT_SET(GPIO_PIN_SER_CLOCK, 1);
-		os_delay_us(DELAY_SHIFT_REG);
-		GPIO_OUTPUT_SET(GPIO_PIN_SER_CLOCK, 0);
-		os_delay_us(DELAY_SHIFT_REG);
+		trend_predict(&route_trends[route_idx], get_uptime_sec(), &duration);
 	}
-	GPIO_OUTPUT_SET(GPIO_PIN_READ_LATCH, 1);
-	os_delay_us(DELAY_SHIFT_REG);
-	GPIO_OUTPUT_SET(GPIO_PIN_READ_LATCH, 0);
-	os_delay_us(DELAY_SHIFT_REG);
+	return duration;
 }
 
-static void show_blank(bool phase)
+// Trend marker of route shown on 'led_count' LEDs - route time is expected to change by one LED step
+static sint8 get_trend_direction(uint8 route_idx, uint16 led_count)
 {
-	uint16 i;
-	for (i = 0; i < LED_COUNT; ++i)
+	if (TREND_DISPLAY_MODE != TREND_DISPLAY_INDICATOR || route_durations[route_idx] <= 0)
 	{
-		GPIO_OUTPUT_SET(GPIO_PIN_SER_DATA, (i == (LED_COUNT - 1)) && phase);
-		os_delay_us(DELAY_SHIFT_REG);
-		GPIO_OUTPUT_SET(GPIO_PIN_SER_CLOCK, 1);
-		os_delay_us(DELAY_SHIFT_REG);
-		GPIO_OUTPUT_SET(GPIO_PIN_SER_CLOCK, 0);
-		os_delay_us(DELAY_SHIFT_REG);
+		return TREND_STABLE;
+	}
+	const struct route_info* route = &route_table[route_idx];
+	return trend_direction(&route_trends[route_idx], (route->worst_time - route->best_time) / led_count);
+}
+
+// Checks whether all legs of route with legs are known (legs display mode)
+static bool is_route_legs_known(uint8 route_idx)
+{
+	const struct route_info* route = &route_table[route_idx];
+	uint8 i;
+	if (ROUTE_DISPLAY_MODE != ROUTE_DISPLAY_LEGS || route->legs_count < 2)
+	{
+		return false;
+	}
+	for (i = 0; i < route->legs_count; ++i)
+	{
+		if (leg_durations[route->first_leg_idx + i] <= 0)
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+// Shows route levels: either currently displayed route over the whole bar (split into its legs in legs display mode),
+// or all routes side by side
+static void show_routes(void)
+{
+	uint16 levels[ROUTE_COUNT > ROUTE_MAX_LEGS ? ROUTE_COUNT : ROUTE_MAX_LEGS];
+	sint8 directions[ROUTE_COUNT > ROUTE_MAX_LEGS ? ROUTE_COUNT : ROUTE_MAX_LEGS];
+	uint8 i;
+	if (is_route_legs_known(displayed_route))
+	{
+		const struct route_info* route = &route_table[displayed_route];
+		uint16 segment_size = LED_COUNT / route->legs_count;
+		is_trend_shown = false;
+		for (i = 0; i < route->legs_count; ++i)
+		{
+			const struct route_leg* leg = &ROUTE_LEGS[route->first_leg_idx + i];
+			levels[i] = calculate_level(leg_durations[route->first_leg_idx + i], leg->best_time, leg->worst_time, segment_size);
+			directions[i] = TREND_STABLE;
+			OS_UART_LOG("[INFO] Indicating route %d leg %d level: %d\n", displayed_route, i, levels[i]);
+		}
+		effects_set_markers(directions, route->legs_count);
+		effects_set_levels(levels, route->legs_count, segment_size);
+	}
+	else if (ROUTE_DISPLAY_MODE == ROUTE_DISPLAY_SPLIT && ROUTE_COUNT > 1)
+	{
+		uint16 segment_size = LED_COUNT / ROUTE_COUNT;
+		is_trend_shown = false;
+		for (i = 0; i < ROUTE_COUNT; ++i)
+		{
+			sint32 duration = get_display_duration(i);
+			levels[i] = duration > 0 ? calculate_level(duration, route_table[i].best_time, route_table[i].worst_time, segment_size) : 0;
+			directions[i] = get_trend_direction(i, segment_size);
+			is_trend_shown |= (directions[i] != TREND_STABLE);
+			OS_UART_LOG("[INFO] Indicating route %d level: %d (trend: %d)\n", i, levels[i], directions[i]);
+		}
+		effects_set_markers(directions, ROUTE_COUNT);
+		effects_set_levels(levels, ROUTE_COUNT, segment_size);
+	}
+	else if (route_durations[displayed_route] > 0)
+	{
+		const struct route_info* route = &route_table[displayed_route];
+		levels[0] = calculate_level(get_display_duration(displayed_route), route->best_time, route->worst_time, LED_COUNT);
+		directions[0] = get_trend_direction(displayed_route, LED_COUNT);
+		is_trend_shown = (directions[0] != TREND_STABLE);
+		OS_UART_LOG("[INFO] Indicating route %d level: %d (trend: %d)\n", displayed_route, levels[0], directions[0]);
+		effects_set_markers(directions, 1);
+		effects_set_levels(levels, 1, LED_COUNT);
 	}
-	GPIO_OUTPUT_SET(GPIO_PIN_READ_LATCH, 1);
-	os_delay_us(DELAY_SHIFT_REG);
-	GPIO_OUTPUT_SET(GPIO_PIN_READ_LATCH, 0);
-	os_delay_us(DELAY_SHIFT_REG);
 }
 
 // ******************************** CONNECTION STATUS *********************************
 
+// Monotonic uptime in seconds (scheduler clock)
+static uint32 get_uptime_sec(void)
+{
+	return (uint32)(sched_now_ms() / 1000);
+}
+
 static bool is_station_connecting(void)
 {
 	uint8 status = wifi_station_get_connect_status();
@@ -191,33 +474,43 @@ static bool is_station_connected(void)
 	return wifi_station_get_connect_status() == STATION_GOT_IP;
 }
 
-static bool is_secure(void)
+// Route query is submitted to HTTP client and not completed yet
+static bool is_query_active(void)
 {
-	return url_prefix_type == HTTP_URL_HTTPS;
+	return query_request.state != HTTP_REQUEST_IDLE;
 }
 
 // ******************************** WIFI CONNECT COMMAND ********************************
 
-void connection_configure(void)
+void connection_configure(struct station_config* sta_conf)
 {
 	char ssid[] = WIFI_SSID;
 	char password[] = WIFI_PASSPHRASE;
-	struct station_config sta_conf = { 0 };
+	const struct config_record* config = config_get();
 
-	os_memcpy(sta_conf.ssid, ssid, sizeof(ssid));
-	os_memcpy(sta_conf.password, password, sizeof(password));
-	wifi_station_set_config(&sta_conf);
-	wifi_station_set_auto_connect(true);
-	wifi_station_set_reconnect_policy(true);
+	os_bzero(sta_conf, sizeof(struct station_config));
+	if (config && config->wifi_ssid[0])
+	{
+		os_strncpy((char*)sta_conf->ssid, config->wifi_ssid, sizeof(sta_conf->ssid));
+		os_strncpy((char*)sta_conf->password, config->wifi_passphrase, sizeof(sta_conf->password));
+	}
+	else
+	{
+		os_memcpy(sta_conf->ssid, ssid, sizeof(ssid));
+		os_memcpy(sta_conf->password, password, sizeof(password));
+	}
 }
 
+// Connects to access point of the last connection directly with its DHCP lease if it is known
+// (see utils/mod_station.c), with channel scan and DHCP otherwise
 void connect(void)
 {
 	if (!is_station_connecting())
 	{
+		struct station_config sta_conf;
 		OS_UART_LOG("\n[INFO] Connecting to predefined SSID ...\n");
-		connection_configure();
-		if (wifi_station_connect())
+		connection_configure(&sta_conf);
+		if (station_connect(&sta_conf))
 		{
 			OS_UART_LOG("[INFO] Command \"connect\" has been submitted\n");
 		}
@@ -237,426 +530,677 @@ void connect(void)
 
 // Forward-declarations
 
-void close_espconn_resources(struct espconn* pconn);
+void finish_query(void);
 void process_content(void);
+bool submit_query(const char* url);
+void request_query(void);
+void update_effects(void);
+static bool sleep_after_failure(void);
 
 // Callback methods
 
-static void ICACHE_FLASH_ATTR on_dns_ip_resoved_callback(const char* hostnaname, ip_addr_t* ip, void* arg);
-static void ICACHE_FLASH_ATTR on_tcp_connected_callback(void* arg);
-static void ICACHE_FLASH_ATTR on_tcp_receive_data_callback(void* arg, char* user_data, unsigned short len);
-static void ICACHE_FLASH_ATTR on_tcp_close_callback(void* arg);
-static void ICACHE_FLASH_ATTR on_tcp_failed_callback(void* arg, sint8 error_type);
+static void ICACHE_FLASH_ATTR on_json_content_callback(void* arg, const char* data, size_t len);
+static void ICACHE_FLASH_ATTR on_json_value_callback(void* arg, const struct json_stream* stream, uint8 type, const char* value, size_t len);
+static void ICACHE_FLASH_ATTR on_query_completed_callback(struct http_request* request, uint8 result);
 
-// ON IP ADDRESS RESOLVED BY HOSTNAME callback method
+// JSON CONTENT callback method (triggered with plain or inflated body bytes as they arrive)
 
-static void ICACHE_FLASH_ATTR on_dns_ip_resoved_callback(const char* hostnaname, ip_addr_t* ip, void* arg)
+static void ICACHE_FLASH_ATTR on_json_content_callback(void* arg, const char* data, size_t len)
 {
-	struct espconn* pconn = (struct espconn*)arg;
-	if (ip)
+	if (!json_stream_feed(&json_parser, data, len))
+	{
+		OS_UART_LOG("[ERROR] Malformed JSON content\n");
+	}
+}
+
+// JSON VALUE callback method (triggered for each scalar JSON value)
+
+// (Directions API fields are stored by field table, Distance Matrix route times are dispatched by element indices)
+static void ICACHE_FLASH_ATTR on_json_value_callback(void* arg, const struct json_stream* stream, uint8 type, const char* value, size_t len)
+{
+	const struct route_query* query = &QUERY_PLAN[query_plan_idx];
+	uint16 indices[2];
+	if (query->type != ROUTE_QUERY_DISTANCE_MATRIX ||
+			stream->field_idx != JSON_FIELD_IDX_MATRIX_DURATION ||
+			type != JSON_VALUE_NUMBER ||
+			json_stream_field_indices(stream, indices) != 2)
+	{
+		return;
+	}
+	if (query->route_idx != ROUTE_QUERY_BATCH)
 	{
-		OS_UART_LOG("[INFO] IP address by hostname `%s` is resolved: %d.%d.%d.%d\n",
-				hostnaname,
-				*((uint8*)&ip->addr),
-				*((uint8*)&ip->addr+1),
-				*((uint8*)&ip->addr+2),
-				*((uint8*)&ip->addr+3));
-		// TCP port configured to 80 (or 433) to make standard HTTP (or HTTPS) request
-		if (is_secure())
+		// route with legs: single-element query of one leg
+		if (indices[0] == 0 && indices[1] == 0 && query->leg_idx < route_table[query->route_idx].legs_count)
 		{
-			pconn->proto.tcp->remote_port = 443;
+			parsed_leg_durations[query->leg_idx] = strtol(value, NULL, 10);
+			parsed_legs_mask |= (1 << query->leg_idx);
 		}
-		else
+		return;
+	}
+	uint8 i;
+	for (i = 0; i < ROUTE_COUNT; ++i)
+	{
+		if (route_table[i].query_idx == query_plan_idx && route_table[i].origin_idx == indices[0] && route_table[i].destination_idx == indices[1])
 		{
-			pconn->proto.tcp->remote_port = 80;
+			parsed_durations[i] = strtol(value, NULL, 10);
+			is_duration_parsed[i] = true;
 		}
-		// TCP IP address configured to value resolved by DNS
-		os_memcpy(pconn->proto.tcp->remote_ip, &ip->addr, 4);
-		espconn_regist_connectcb(pconn, on_tcp_connected_callback);
-		espconn_regist_reconcb(pconn, on_tcp_failed_callback);
+	}
+}
+
+// Scheduler wakeups and per-task run counts
+static void print_sched_stats(void)
+{
 #ifdef UART_DEBUG_LOGS
-		char res_status[LABEL_BUFFER_SIZE];
+	os_printf("[INFO] Scheduler wakeups: %d, task runs:", sched_get_stats()->wakeups);
+	sint8 i;
+	const struct sched_task* task;
+	for (i = 0; (task = sched_get_task(i)) != NULL; ++i)
+	{
+		os_printf(" %s=%d", task->name, task->run_count);
+	}
+	os_printf("\n");
 #endif
-		// Establishes TCP connection
-		if (is_secure())
-		{
-			sint8 res = espconn_secure_connect(pconn);
+}
+
+// QUERY COMPLETED callback method (triggered once response is received or query has failed)
+
+static void ICACHE_FLASH_ATTR on_query_completed_callback(struct http_request* request, uint8 result)
+{
 #ifdef UART_DEBUG_LOGS
-			lookup_espconn_error(res_status, res);
-			os_printf("[INFO] Establishing secure TCP connection... %s\n", res_status);
+	char error_info[LABEL_BUFFER_SIZE];
 #endif
-		}
-		else
-		{
-			sint8 res = espconn_connect(pconn);
+	switch (result)
+	{
+		case HTTP_RESULT_OK:
+		case HTTP_RESULT_ERROR_RESPONSE:
+			OS_UART_LOG("[INFO] HTTP content has been received (status: %d, parser result: %d, body: %d bytes)\n",
+					request->parser.status_code,
+					request->parser.error,
+					request->parser.body_size);
+			process_content();
+			break;
+		case HTTP_RESULT_ERROR_INFLATE:
+			// re-submitting the same query without compression (e.g. history window does not fit into heap)
+			OS_UART_LOG("[WARNING] Unable to inflate gzip content: %d (window: %d bytes, max back reference: %d bytes), falling back to identity encoding\n",
+					request->inflater.error,
+					1 << request->window_bits,
+					request->inflater.max_distance);
+			request_query();
+			break;
+		case HTTP_RESULT_ERROR_DNS:
+			OS_UART_LOG("[ERROR] Unable get IP address by hostname `%s`\n", request->hostname);
+			query_error_flag = true;
+			sleep_after_failure();
+			break;
+		default:
 #ifdef UART_DEBUG_LOGS
-			lookup_espconn_error(res_status, res);
-			os_printf("[INFO] Establishing TCP connection... %s\n", res_status);
+			lookup_espconn_error(error_info, request->connection_error);
+			os_printf("[ERROR] Connection to `%s` has failed: %s\n", request->hostname, error_info);
 #endif
-		}
-	}
-	else
-	{
-		OS_UART_LOG("[ERROR] Unable get IP address by hostname `%s`\n", hostnaname);
-		close_espconn_resources(pconn);
-		query_error_flag = true;
+			query_error_flag = true;
+			if (!sleep_after_failure())
+			{
+				is_retry_pending = true;
+				sched_set_deadline(query_task, TIMER_PERIOD_CONN_RETRY);
+			}
+			break;
 	}
+	finish_query();
 }
 
-// ON-SUCCESSFUL TCP CONNECT callback method (triggered upon TCP connection is established, but download has not stared yet)
-
-static void ICACHE_FLASH_ATTR on_tcp_connected_callback(void* arg)
+// Releases per-query resources upon query completion (connection may stay alive in keep-alive mode)
+void finish_query(void)
 {
-	OS_UART_LOG("[INFO] TCP connection is established\n");
-	struct espconn* pconn = (struct espconn*)arg;
-	espconn_regist_disconcb(pconn, on_tcp_close_callback);
-	espconn_regist_recvcb(pconn, on_tcp_receive_data_callback);
+	const struct http_client_stats* stats = http_client_get_stats();
+	OS_UART_LOG("[INFO] Query completed. Handshake: %d ms (connection reused: %d, retries: %d), min free heap: %d bytes, "
+			"arena high-water mark: %d of %d bytes, DNS cache hits: %d, misses: %d\n",
+			query_request.handshake_duration / 1000,
+			query_request.is_connection_reused,
+			stats->retries,
+			query_request.min_free_heap,
+			arena_high_water(),
+			ARENA_SIZE,
+			dns_cache_get_stats()->hits,
+			dns_cache_get_stats()->misses);
+	METRICS_FINISH_QUERY();
+	METRICS_PRINT();
+	arena_reset();
+	print_sched_stats();
+}
 
-	char* tx_buf = (char*)os_malloc(HTTP_TX_BUFFER_SIZE);
-	os_sprintf(tx_buf, "GET %s HTTP/1.1\r\nHost: %s\r\nAccept: */*\r\n\r\n", http_path, http_hostname);
-	OS_UART_LOG("[DEBUG] HTTP TX buffer:\n%s\n", tx_buf);
-	if (is_secure())
+// Submits route query of current QUERY_PLAN entry to HTTP client
+bool submit_query(const char* url)
+{
+	// Reset response parsing state left from previous submission
+	json_stream_init(&json_parser, on_json_value_callback, NULL);
+	os_bzero(&parsed_fields, sizeof(struct route_fields));
+	// leg times are collected across leg queries of the route (reset by its first one)
+	if (QUERY_PLAN[query_plan_idx].leg_idx == 0)
+	{
+		parsed_legs_mask = 0;
+	}
+	if (QUERY_PLAN[query_plan_idx].type == ROUTE_QUERY_DISTANCE_MATRIX)
 	{
-		espconn_secure_send(pconn, tx_buf, os_strlen(tx_buf));
+		json_stream_set_fields(&json_parser, JSON_MATRIX_FIELDS, sizeof(JSON_MATRIX_FIELDS) / sizeof(struct json_field), &parsed_fields);
 	}
 	else
 	{
-		espconn_send(pconn, tx_buf, os_strlen(tx_buf));
+		json_stream_set_fields(&json_parser, JSON_DIRECTIONS_FIELDS, sizeof(JSON_DIRECTIONS_FIELDS) / sizeof(struct json_field), &parsed_fields);
 	}
-        os_free(tx_buf);
+	os_bzero(parsed_durations, sizeof(parsed_durations));
+	os_bzero(is_duration_parsed, sizeof(is_duration_parsed));
+	http_request_init(&query_request, on_json_content_callback, on_query_completed_callback, NULL);
+	query_request.is_keep_alive = KEEP_ALIVE_MODE;
+	query_request.is_gzip = GZIP_MODE;
+	METRICS_BEGIN(METRICS_PHASE_QUERY);
+	return http_client_submit(&query_request, url);
 }
 
-// ON-SUCCESSFUL TCP DISCONNECT callback method (triggered upon successful HTTP response download completed and socket connection is closed)
-
-static void ICACHE_FLASH_ATTR on_tcp_close_callback(void* arg)
+// Local wall clock time (seconds, 0 - neither synchronized with SNTP nor restored from RTC memory yet)
+static uint32 get_local_timestamp(void)
 {
-	OS_UART_LOG("[INFO] TCP connection closed\n");
-	struct espconn* pconn = (struct espconn*)arg;
-	close_espconn_resources(pconn);
-	process_content();
+	return clock_get_local_time();
 }
 
-// ON-FAILED TCP CONNECT callback method (triggered in case of TCP connection cannot be established, used for re-try logic)
-
-static void ICACHE_FLASH_ATTR on_tcp_failed_callback(void* arg, sint8 error_type)
+// Picks next update time according to traffic volatility, time of day and remaining daily budget
+uint32 schedule_next_query(void)
 {
-#ifdef UART_DEBUG_LOGS
-	char error_info[LABEL_BUFFER_SIZE];
-	lookup_espconn_error(error_info, error_type);
-	os_printf("[ERROR] Failed to establish TCP connection: %s\n", error_info);
-#endif
-	struct espconn* pconn = (struct espconn*)arg;
-	close_espconn_resources(pconn);
-	query_error_flag = true;
-	retry_tick_index = tick_index;
+	uint32 interval = poll_next_interval(get_uptime_sec(), get_local_timestamp(), QUERY_PLAN_ELEMENTS);
+	sched_set_deadline(query_task, interval * 1000);
+	OS_UART_LOG("[INFO] Next update in %d sec (volatility: %d sec/hour, requests today: %d of %d)\n",
+			interval,
+			poll_get_stats()->volatility,
+			poll_get_stats()->requests_today,
+			POLL_DAILY_BUDGET);
+	return interval;
 }
 
-// TCP DATA RECEIVE callback method
-
-static void ICACHE_FLASH_ATTR on_tcp_receive_data_callback(void* arg, char* user_data, unsigned short len)
+// Saves route times and polling state into RTC memory upon completed update
+static void save_display_state(uint32 next_update_delay)
 {
-	if (!is_transfer_completed)
+	struct display_state state;
+	os_memcpy(state.route_durations, route_durations, sizeof(route_durations));
+	state.rtc_time = system_get_rtc_time();
+	state.rtc_period = system_rtc_clock_cali_proc();
+	state.next_update_delay = next_update_delay;
+	state.poll_stats = *poll_get_stats();
+	if (!rtcmem_write(RTCMEM_SLOT_DISPLAY_STATE, &state, sizeof(struct display_state)))
 	{
-		OS_UART_LOG("[DEBUG] On TCP data receive callback handler. Bytes received: %d.\n", len);
-		char* local_content = (char*)os_malloc(local_http_receive_idx + len + 1);
-		if (local_http_receive_idx > 0)
-		{
-			os_memcpy(local_content, http_content, local_http_receive_idx);
-			os_free(http_content);
-		}
-		os_memcpy(&local_content[local_http_receive_idx], user_data, len);
-		http_content = local_content;
-		local_http_receive_idx += len;
-		http_content[local_http_receive_idx] = 0;
-		if (is_end_of_content(http_content))
-		{
-			local_http_receive_idx = 0;
-			OS_UART_LOG("[INFO] Full HTTP content has been received\n");
-			is_transfer_completed = true;
-		}
+		OS_UART_LOG("[WARNING] Unable to save display state into RTC memory\n");
 	}
 }
 
-// Releases ESP connection resources
-void close_espconn_resources(struct espconn* pconn)
+// Restores route times saved before reset: levels are shown right away (with staleness indicator),
+// refresh is scheduled according to their age
+static void restore_display_state(void)
 {
-	if (pconn)
+	struct display_state state;
+	if (!rtcmem_read(RTCMEM_SLOT_DISPLAY_STATE, &state, sizeof(struct display_state)))
+	{
+		return;
+	}
+	// RTC timer keeps counting across software resets and deep sleep, after external reset it restarts
+	// (age wraps around to a large value, so refresh is due right away)
+	uint32 age = (uint32)((((uint64)(system_get_rtc_time() - state.rtc_time) * state.rtc_period) >> 12) / 1000000);
+	uint8 i;
+	for (i = 0; i < ROUTE_COUNT; ++i)
 	{
-		if (pconn->proto.tcp)
+		route_durations[i] = state.route_durations[i];
+		if (route_durations[i] > 0)
 		{
-			os_free(pconn->proto.tcp);
-			pconn->proto.tcp = NULL;
+			empty_response_flag = false;
 		}
-		OS_UART_LOG("[INFO] TCP connection resources released\n");
-		os_free(pconn);
-		pespconn = NULL;
 	}
-	is_transfer_started = false;
+	if (empty_response_flag)
+	{
+		return;
+	}
+	poll_restore(&state.poll_stats);
+	is_state_restored = true;
+	last_update_time = (sint32)get_uptime_sec() - (sint32)age;
+	is_last_update_known = true;
+	restored_refresh_delay = age < state.next_update_delay ? (state.next_update_delay - age) * 1000 : 0;
+	OS_UART_LOG("[INFO] Restored route times from RTC memory (age: %d sec, refresh in %d sec)\n",
+			age,
+			restored_refresh_delay / 1000);
 }
 
-// os_sprintf does not supports '%.6f' formatting rule, composing it manually
-void print_coords(char* output, double lat, double lng)
+// HTTP JSON Content Parsing
+void process_content(void)
 {
-	char* target = output;
-	uint32 whole;
-	if (lat < 0.0)
+	const struct route_query* query = &QUERY_PLAN[query_plan_idx];
+	METRICS_RESUME(METRICS_PHASE_PARSE);
+	const struct http_response_parser* http_parser = &query_request.parser;
+	bool is_response_complete = http_parser->body_size > 0 && http_parser->state == HTTP_STATE_DONE;
+	bool result_found = false;
+	uint8 i;
+	if (http_parser->body_size == 0)
 	{
-		lat = -lat;
-		whole = (uint32)lat;
-		target += os_sprintf(target, "-%ld.%06ld", whole, ((uint32)(lat * 1000000)) - (whole * 1000000));
+		OS_UART_LOG("[ERROR] HTTP content is empty\n");
 	}
-	else
+	if ((json_parser.fields_found & (1UL << JSON_FIELD_IDX_STATUS)) && os_strcmp(parsed_fields.status, "OK") != 0)
+	{
+		OS_UART_LOG("[ERROR] API response status: %s\n", parsed_fields.status);
+	}
+	if (query->type == ROUTE_QUERY_DISTANCE_MATRIX && query->route_idx != ROUTE_QUERY_BATCH)
+	{
+		const struct route_info* route = &route_table[query->route_idx];
+		if (!is_response_complete)
+		{
+			parsed_legs_mask &= ~(1 << query->leg_idx);
+		}
+		if (route->query_idx != query_plan_idx)
+		{
+			// not the last leg of the route yet - route is updated once all its leg queries are done
+			if (is_response_complete)
+			{
+				METRICS_END(METRICS_PHASE_PARSE);
+				METRICS_END(METRICS_PHASE_QUERY);
+			}
+			++query_plan_idx;
+			request_query();
+			return;
+		}
+		// route time of route with legs is the sum of leg times, it is known only if all legs are
+		bool is_legs_complete = parsed_legs_mask == (1 << route->legs_count) - 1;
+		parsed_durations[query->route_idx] = 0;
+		for (i = 0; i < route->legs_count; ++i)
+		{
+			leg_durations[route->first_leg_idx + i] = is_legs_complete ? parsed_leg_durations[i] : -1;
+			parsed_durations[query->route_idx] += parsed_leg_durations[i];
+			OS_UART_LOG("[INFO] Route %d leg %d: %d sec\n", query->route_idx, i, leg_durations[route->first_leg_idx + i]);
+		}
+		is_duration_parsed[query->route_idx] = is_legs_complete;
+	}
+	if (query->type == ROUTE_QUERY_DIRECTIONS && (json_parser.fields_found & (1UL << JSON_FIELD_IDX_DURATION)))
 	{
-		whole = (uint32)lat;
-		target += os_sprintf(target, "%ld.%06ld", whole, ((uint32)(lat * 1000000)) - (whole * 1000000));
+		parsed_durations[query->route_idx] = parsed_fields.duration_in_traffic;
+		is_duration_parsed[query->route_idx] = true;
+		OS_UART_LOG("[INFO] Route %d via %s: %d m, %d sec (%d sec without traffic)\n",
+				query->route_idx,
+				parsed_fields.summary,
+				parsed_fields.distance,
+				parsed_fields.duration_in_traffic,
+				parsed_fields.duration);
 	}
-	if (lng < 0.0)
+	for (i = 0; i < ROUTE_COUNT; ++i)
 	{
-		lng = -lng;
-		whole = (uint32)lng;
-		target += os_sprintf(target, "%%2C-%ld.%06ld", whole, ((uint32)(lng * 1000000)) - (whole * 1000000));
+		if (route_table[i].query_idx != query_plan_idx)
+		{
+			continue;
+		}
+		if (is_response_complete && is_duration_parsed[i])
+		{
+			if (route_durations[i] > 0)
+			{
+				sint32 delta = parsed_durations[i] - route_durations[i];
+				uint32 change = delta < 0 ? -delta : delta;
+				update_change = change > update_change ? change : update_change;
+			}
+			route_durations[i] = parsed_durations[i];
+			trend_add(&route_trends[i], get_uptime_sec(), route_durations[i]);
+			result_found = true;
+			OS_UART_LOG("[INFO] Parsed time duration value of route %d successfully: %d\n", i, route_durations[i]);
+		}
+		else
+		{
+			route_durations[i] = -1;
+			OS_UART_LOG("[ERROR] Unable to find time duration of route %d in JSON response\n", i);
+		}
 	}
-	else
+	query_error_flag = !result_found;
+	is_state_restored = false;
+	if (result_found)
 	{
-		whole = (uint32)lng;
-		target += os_sprintf(target, "%%2C%ld.%06ld", whole, ((uint32)(lng * 1000000)) - (whole * 1000000));
+		last_update_time = get_uptime_sec();
+		is_last_update_known = true;
+		METRICS_END(METRICS_PHASE_PARSE);
+		METRICS_END(METRICS_PHASE_QUERY);
 	}
-}
 
-// Direction API request composition
-void compose_http_request_url(char* url)
-{
-	char str_coords[100];
-	char* target = url;
-	// url basis
-	target += os_sprintf(target, DIRECTIONS_API_BASE_URL);
-	// route start position
-	print_coords(str_coords, START_POSITION.lat, START_POSITION.lng);
-	target += os_sprintf(target, "%s=%s", DIRECTIONS_API_TAG_START, str_coords);
-	// route intermediate waypoints
-	size_t waypoints_number = sizeof(WAYPOINTS) / sizeof(struct gps_coords);
-	if (waypoints_number)
+	empty_response_flag = true;
+	for (i = 0; i < ROUTE_COUNT; ++i)
+	{
+		if (route_durations[i] > 0)
+		{
+			empty_response_flag = false;
+		}
+	}
+	if (!empty_response_flag)
+	{
+		if (route_durations[displayed_route] <= 0)
+		{
+			displayed_route = query->type == ROUTE_QUERY_DISTANCE_MATRIX ? displayed_route : query->route_idx;
+		}
+		show_routes();
+	}
+	update_effects();
+
+	// Chaining next query of the plan (submitted by main loop once current query is finished)
+	if (query_plan_idx + 1 < QUERY_PLAN_SIZE)
 	{
-		target += os_sprintf(target, "&%s=", DIRECTIONS_API_TAG_WAYPOINTS);
+		++query_plan_idx;
+		request_query();
 	}
-	int i;
-	for (i = 0; i < waypoints_number; ++i)
+	else if (!empty_response_flag)
 	{
-		if (i)
+		poll_on_result(get_uptime_sec(), update_change);
+		update_change = 0;
+		deep_sleep_duration = schedule_next_query();
+		save_display_state(deep_sleep_duration);
+		if (DEEP_SLEEP_MODE)
 		{
-			target += os_sprintf(target, "%%7C");
+			sched_set_deadline(sleep_task, TIMER_PERIOD_SLEEP);
 		}
-		print_coords(str_coords, WAYPOINTS[i].lat, WAYPOINTS[i].lng);
-		target += os_sprintf(target, "via%%3A%s", str_coords);
 	}
-	// route end position
-	print_coords(str_coords, END_POSITION.lat, END_POSITION.lng);
-	target += os_sprintf(target, "&%s=%s", DIRECTIONS_API_TAG_END, str_coords);
-	// route query time
-	target += os_sprintf(target, "&%s", DIRECTIONS_API_TIME);
-	// query key
-	target += os_sprintf(target, "&%s=%s", DIRECTIONS_API_TAG_KEY, HTTP_QUERY_KEY);
+	else
+	{
+		sleep_after_failure();
+	}
 }
 
-// Clears HTTP downloaded content memory;
-void release_http_content(void)
+// Deep sleep mode: failed update is re-tried after DEEP_SLEEP_RETRY_INTERVAL rather than by staying awake,
+// returns false if device stays awake (deep sleep mode is off)
+static bool sleep_after_failure(void)
 {
-	if (http_content)
+	if (!DEEP_SLEEP_MODE)
 	{
-		os_free(http_content);
-		http_content = NULL;
+		return false;
 	}
+	deep_sleep_duration = DEEP_SLEEP_RETRY_INTERVAL;
+	sched_set_deadline(sleep_task, TIMER_PERIOD_SLEEP);
+	return true;
 }
 
-// Actual HTTP request execution
-void http_request(const char* url)
+// ############################# APPLICATION MAIN LOOP TASKS (TRIGGERED BY SCHEDULER) #############################
+
+// Submits query right away: next query of query plan, or re-submission of current one
+void request_query(void)
 {
-	// Memory allocation for pespconn
-	pespconn = (struct espconn*)os_zalloc(sizeof(struct espconn));
-	// ESP connection setup for TCP
-	pespconn->type = ESPCONN_TCP;
-	pespconn->state = ESPCONN_NONE;
-	// Configuring ESP TCP settings
-	pespconn->proto.tcp = (esp_tcp *)os_zalloc(sizeof(esp_tcp));
-	// Performing basic URL parsing to extract hostname and HTTP path
-	url_prefix_type = parse_url(url, http_hostname, http_path);
-	OS_UART_LOG("[INFO] Trying to resolve IP address by hostname `%s` ...\n", http_hostname);
-	// Clean HTTP Content loaded on previous submission
-	release_http_content();
-	// Resolve IP address by hostname
-	espconn_gethostbyname(pespconn, http_hostname, &target_server_ip, on_dns_ip_resoved_callback);
+	pending_query_flag = true;
+	sched_set_deadline(query_task, 0);
 }
 
-// HTTP JSON Content Parsing
-void process_content(void)
+static void conn_task_handler(void* arg)
 {
-	if (http_content)
+	if (!is_station_connected() && DEEP_SLEEP_MODE && sched_now_ms() >= DEEP_SLEEP_CONNECT_TIMEOUT)
 	{
-		char* json_body = (char*)os_zalloc(os_strlen(http_content));
-		parse_http_body(http_content, json_body);
-		release_http_content();
-		bool result_found = false;
-		char value_buffer[LABEL_BUFFER_SIZE];
-		os_bzero(value_buffer, LABEL_BUFFER_SIZE);
+		OS_UART_LOG("[WARNING] No WiFi connection %d ms after wake-up\n", (uint32)sched_now_ms());
+		sleep_after_failure();
+	}
+	else if (!is_station_connected())
+	{
+		connect();
+	}
+}
 
-		// "duration_in_traffic" section extraction - to do not parse full heavy HTTP JSON response
-		char* duration_section = os_strstr(json_body, JSON_TAG_DURATION);
-		if (duration_section)
-		{
-			duration_section = os_strstr(duration_section, "{");
-		}
-		char* duration_section_end = 0;
-		if (duration_section)
-		{
-			duration_section_end = os_strstr(duration_section, "}");
-		}
-		if (duration_section && duration_section_end)
-		{
-			duration_section_end[1] = 0;
-			OS_UART_LOG("[INFO] Parsing JSON section:\n%s\n\n", duration_section);
-			// JSON parsing
-			struct jsonparse_state parser;
-			jsonparse_setup(&parser, duration_section, os_strlen(duration_section));
-			int node_type;
-			while ((node_type = jsonparse_next(&parser)) != 0 && !result_found)
-			{
-				if (node_type == JSON_TYPE_PAIR_NAME && jsonparse_strcmp_value(&parser, JSON_TAG_NESTED_VALUE) == 0
-												&& jsonparse_get_len(&parser) == os_strlen(JSON_TAG_NESTED_VALUE)
-												&& parser.depth == JSON_DEPTH_NESTED_VALUE)
-				{
-					jsonparse_next(&parser);
-					node_type = jsonparse_next(&parser);
-					if (node_type == JSON_TYPE_NUMBER)
-					{
-						jsonparse_copy_value(&parser, value_buffer, sizeof(value_buffer));
-						result_found = true;
-					}
-				}
-			}
-		}
-		if (result_found)
-		{
-			duration_value = strtol(value_buffer, NULL, 10);
-			OS_UART_LOG("[INFO] Parsed time duration value successfully: %d\n", duration_value);
-		}
-		else
-		{
-			duration_value = -1;
-			OS_UART_LOG("[ERROR] Unable to find time duration in JSON response\n");
-		}
-		os_free(json_body);
-		query_error_flag = !result_found;
+// Picks status LED and LED bar effects according to connection and query state
+void update_effects(void)
+{
+	if (is_station_connected() && query_error_flag)
+	{
+		// please enable UART_DEBUG_LOGS to investigate if you have such issue
+		effects_play(EFFECT_CHANNEL_STATUS, &EFFECT_STATUS_ERROR);
+	}
+	else if (is_state_restored)
+	{
+		effects_play(EFFECT_CHANNEL_STATUS, &EFFECT_STATUS_STALE);
+	}
+	else if (!is_station_connected())
+	{
+		effects_play(EFFECT_CHANNEL_STATUS, &EFFECT_STATUS_OFF);
 	}
 	else
 	{
-		OS_UART_LOG("[ERROR] HTTP content is empty\n");
-		query_error_flag = true;
-		duration_value = -1;
+		effects_play(EFFECT_CHANNEL_STATUS, &EFFECT_HEARTBEAT);
 	}
 
-	if (duration_value > 0)
+	if (!empty_response_flag)
 	{
-		uint16 trafic_level = calculate_level(duration_value);
-		empty_response_flag = false;
-		show_level(trafic_level);
+		effects_play(EFFECT_CHANNEL_BAR, is_trend_shown ? &EFFECT_LEVELS_TREND : &EFFECT_LEVELS);
+	}
+	else if (is_station_connected() && query_error_flag)
+	{
+		effects_play(EFFECT_CHANNEL_BAR, &EFFECT_BAR_ERROR);
 	}
 	else
 	{
-		empty_response_flag = true;
+		effects_play(EFFECT_CHANNEL_BAR, &EFFECT_BLANK);
 	}
 }
 
-// ############################# APPLICATION MAIN LOOP METHOD (TRIGGERED EACH 10 MS) #############################
+static void status_task_handler(void* arg)
+{
+	update_effects();
+}
 
-void main_timer_handler(void* arg)
+// Switching displayed route (cycling display mode)
+static void route_cycle_task_handler(void* arg)
 {
-	++tick_index;
-	if (tick_index % TIMER_PERIOD_CONN == 0)
+	if (ROUTE_DISPLAY_MODE != ROUTE_DISPLAY_SPLIT && ROUTE_COUNT > 1 && !empty_response_flag)
 	{
-		if (!is_station_connected())
+		uint8 i;
+		for (i = 0; i < ROUTE_COUNT; ++i)
 		{
-			connect();
+			displayed_route = (displayed_route + 1) % ROUTE_COUNT;
+			if (route_durations[displayed_route] > 0)
+			{
+				break;
+			}
 		}
+		show_routes();
 	}
+}
+
+// Keeping wall clock anchor in RTC memory up to date
+static void clock_task_handler(void* arg)
+{
+	clock_update();
+}
 
-	if (tick_index % TIMER_PERIOD_LED == 0)
+// Refreshing levels predicted from route time trends (prediction display mode)
+static void trend_task_handler(void* arg)
+{
+	if (!empty_response_flag)
 	{
-		if (is_station_connected())
-		{
-			if (!query_error_flag)
-			{
-				// Build-in LED Heartbeat flashing - when WiFi connection established
-				GPIO_OUTPUT_SET(GPIO_PIN_LED, 0);
-				os_delay_us(DELAY_HEARTBEAT_FLASH);
-				GPIO_OUTPUT_SET(GPIO_PIN_LED, 1);
-			}
-			else
-			{
-				// Build-in LED constantly ON - when WiFi connection established and HTTP query error is present
-				// (please enable UART_DEBUG_LOGS to investigate if you have such issue)
-				GPIO_OUTPUT_SET(GPIO_PIN_LED, 0);
-			}
-		}
+		show_routes();
 	}
+}
 
-	if (tick_index % TIMER_PERIOD_BLANK_LED == 0)
+// Queries route times more often while there is no data to display
+static void initial_query_task_handler(void* arg)
+{
+	if (empty_response_flag)
 	{
-		if (empty_response_flag)
-		{
-			show_blank((tick_index / TIMER_PERIOD_BLANK_LED) % 2);
-		}
+		sched_set_deadline(query_task, 0);
 	}
+}
 
-	if ( ( tick_index % TIMER_PERIOD_QUERY == 0 ) ||
-		 ( retry_tick_index > 0 && ((tick_index - retry_tick_index) > TIMER_PERIOD_CONN_RETRY) ) ||
-		 ( empty_response_flag && (tick_index % TIMER_PERIOD_INITIAL_QUERY == 0) ) )
+static void query_task_handler(void* arg)
+{
+	if (is_retry_pending)
+	{
+		is_retry_pending = false;
+		OS_UART_LOG("[INFO] Re-trying to connect after failure ...\n");
+	}
+	else if (!pending_query_flag)
 	{
-		if (retry_tick_index > 0)
+		// scheduled query - starting query plan over (next update time is refined upon completion),
+		// plan in progress is left to finish when its query is still in flight
+		if (!is_query_active())
 		{
-			retry_tick_index = -1;
-			OS_UART_LOG("[INFO] Re-trying to connect after failure ...\n");
+			query_plan_idx = 0;
 		}
-		if (is_station_connected() && !is_transfer_started)
+		schedule_next_query();
+	}
+	pending_query_flag = false;
+	if (is_station_connected() && !is_query_active() && !clock_is_ready())
+	{
+		// TLS handshake would fail with bogus time - query is re-submitted once clock is known
+		OS_UART_LOG("[INFO] Waiting for SNTP time before submitting HTTP query\n");
+		pending_query_flag = true;
+		sched_set_deadline(query_task, TIMER_PERIOD_CLOCK_WAIT);
+		return;
+	}
+	if (is_station_connected() && !is_query_active())
+	{
+		// API key of runtime config is used with built-in URLs as well (config routes may not match firmware)
+		const struct config_record* config = config_get();
+		bool is_url_loaded = is_config_routes_active ?
+				config_load_url(query_plan_idx, complete_url, sizeof(complete_url)) :
+				routes_load_url(&QUERY_PLAN[query_plan_idx], config ? config->api_key : NULL, complete_url, sizeof(complete_url));
+		if (!is_url_loaded)
 		{
-			is_transfer_started = true;
-			compose_http_request_url(complete_url);
-			OS_UART_LOG("[INFO] Submitting HTTP GET Request: %s\n", complete_url);
-			http_request(complete_url);
+			OS_UART_LOG("[ERROR] Request URL of query %d exceeds %d bytes\n", query_plan_idx, HTTP_URL_BUFFER_SIZE);
+			return;
 		}
-		else
+		poll_on_request(get_uptime_sec(), get_local_timestamp(), QUERY_PLAN[query_plan_idx].elements);
+		OS_UART_LOG("[INFO] Submitting HTTP GET Request: %s\n", complete_url);
+		if (!submit_query(complete_url))
 		{
-			OS_UART_LOG("[WARNING] Unable to submit HTTP query: is_station_connected:%d, is_already_started:%d\n",
-					is_station_connected(),
-					is_transfer_started);
-			if (!is_station_connected())
-			{
-				empty_response_flag = true;
-			}
+			OS_UART_LOG("[ERROR] Unable to submit HTTP GET Request\n");
+			query_error_flag = true;
 		}
 	}
-
-	// Close TCP socket connection upon data transfer is completed
-	if (tick_index % TIMER_PERIOD_CLOSE_SOCKET == 0)
+	else
 	{
-		if (is_transfer_completed)
+		OS_UART_LOG("[WARNING] Unable to submit HTTP query: is_station_connected:%d, is_already_started:%d\n",
+				is_station_connected(),
+				is_query_active());
+		if (!is_station_connected() && is_state_restored)
 		{
-			is_transfer_completed = false;
-			if (is_secure())
-			{
-				espconn_secure_disconnect(pespconn);
-			}
-			else
-			{
-				espconn_disconnect(pespconn);
-			}
+			// restored levels stay on display while refresh waits for connection
+			is_refresh_waiting = true;
+			sched_set_deadline(query_task, TIMER_PERIOD_CONN);
+		}
+		else if (!is_station_connected())
+		{
+			empty_response_flag = true;
 		}
 	}
+}
+
+// The longest deep sleep SDK accepts: time in RTC timer ticks, (time_in_us / cali) << 12, has to stay below 2^31
+// (about 3 hours once 10% is left for calibration drift)
+static uint32 get_deep_sleep_max_duration(void)
+{
+	return (uint32)((((uint64)0x7FFFFFFF * system_rtc_clock_cali_proc()) >> 12) / 1000000 * 9 / 10);
+}
+
+// Enters deep sleep until the next update, levels stay latched in shift registers meanwhile
+static void sleep_task_handler(void* arg)
+{
+	uint32 max_duration = get_deep_sleep_max_duration();
+	if (deep_sleep_duration > max_duration)
+	{
+		// device wakes up earlier and sleeps for the rest of planned interval (see on_user_init_completed)
+		OS_UART_LOG("[INFO] Deep sleep of %d sec is limited to %d sec\n", deep_sleep_duration, max_duration);
+		deep_sleep_duration = max_duration;
+	}
+	effects_skip_transition();
+	// clock is restored from RTC memory after wake-up
+	clock_update();
+	// status LED off (active low)
+	GPIO_OUTPUT_SET(GPIO_PIN_LED, 1);
+	uint64 awake_time = sched_now_ms();
+	uint64 sleep_time = (uint64)deep_sleep_duration * 1000;
+	// charge per update cycle: mA * ms and uA * ms / 1000 are both uA * sec
+	uint64 charge = awake_time * DEEP_SLEEP_ACTIVE_CURRENT + sleep_time * DEEP_SLEEP_SLEEP_CURRENT / 1000;
+	uint32 duty_cycle = (uint32)(awake_time * 10000 / (awake_time + sleep_time));
+	OS_UART_LOG("[INFO] Entering deep sleep for %d sec: awake %d ms (wake to display %d ms), duty cycle %d.%02d%%, "
+			"estimated charge per update %d uAh, average current %d uA\n",
+			deep_sleep_duration,
+			(uint32)awake_time,
+			wake_to_display_time,
+			duty_cycle / 100,
+			duty_cycle % 100,
+			(uint32)(charge / 3600),
+			(uint32)(charge * 1000 / (awake_time + sleep_time)));
+	system_deep_sleep_set_option(DEEP_SLEEP_RF_OPTION);
+	system_deep_sleep(sleep_time * 1000);
+}
+
+// Connect time is tracked by station module, refresh of restored state is submitted as soon as station gets IP address
+static void on_wifi_event_callback(System_Event_t* event)
+{
+	station_on_event(event);
+	if (event->event == EVENT_STAMODE_GOT_IP)
+	{
+		const struct station_stats* stats = station_get_stats();
+		OS_UART_LOG("[INFO] Station got IP address in %d ms (%s connect, fast: %d, scan: %d, fallbacks: %d)\n",
+				stats->is_last_connect_fast ? stats->last_fast_connect_time : stats->last_scan_connect_time,
+				stats->is_last_connect_fast ? "fast" : "scan",
+				stats->fast_connects,
+				stats->scan_connects,
+				stats->fallbacks);
+	}
+	if (event->event == EVENT_STAMODE_GOT_IP && is_refresh_waiting)
+	{
+		is_refresh_waiting = false;
+		sched_set_deadline(query_task, 0);
+	}
+}
 
-	if (tick_index >= TIMER_IDX_RESET)
+// Advances render position by appended length, false once 'end' is reached (appended part is dropped)
+static bool status_advance(char** target, const char* end, int len)
+{
+	if (len < 0 || len >= end - *target)
 	{
-		tick_index = 0;
-		retry_tick_index = -1;
+		return false;
 	}
+	*target += len;
+	return true;
+}
+
+// Renders device status for status endpoint into 'size' bytes - document is truncated at the last complete part
+// if it does not fit (worst-case size is checked against STATUS_BODY_SIZE at compile time), no allocations
+static uint16 render_status(char* output, uint16 size)
+{
+	char* target = output;
+	const char* end = output + size;
+	uint32 uptime = get_uptime_sec();
+	uint8 i;
+	const struct station_stats* station_stats = station_get_stats();
+	if (!status_advance(&target, end, os_snprintf(target, end - target, STATUS_HEAD_FORMAT,
+			uptime,
+			system_get_free_heap_size(),
+			is_station_connected(),
+			station_stats->is_last_connect_fast ? station_stats->last_fast_connect_time : station_stats->last_scan_connect_time,
+			station_stats->is_last_connect_fast,
+			station_stats->fallbacks,
+			clock_get_stats()->source,
+			query_error_flag,
+			empty_response_flag,
+			is_state_restored,
+			is_last_update_known ? (sint32)uptime - last_update_time : -1,
+			poll_get_stats()->last_interval)))
+	{
+		return target - output;
+	}
+	for (i = 0; i < ROUTE_COUNT; ++i)
+	{
+		if (!status_advance(&target, end, os_snprintf(target, end - target, STATUS_ROUTE_FORMAT,
+				i ? "," : "",
+				route_durations[i],
+				route_durations[i] > 0 ? calculate_level(route_durations[i], route_table[i].best_time, route_table[i].worst_time, LED_COUNT) : 0,
+				route_trends[i].slope)))
+		{
+			return target - output;
+		}
+	}
+#ifdef QUERY_METRICS
+	const struct metrics_phase* query_metrics = &metrics_get()->phases[METRICS_PHASE_QUERY];
+	status_advance(&target, end, os_snprintf(target, end - target, STATUS_METRICS_FORMAT,
+			query_metrics->count,
+			query_metrics->failures,
+			query_metrics->avg / 1000,
+			query_metrics->max / 1000,
+			metrics_get()->min_free_heap));
+#else
+	status_advance(&target, end, os_snprintf(target, end - target, STATUS_TAIL_FORMAT));
+#endif
+	return target - output;
 }
 
 // ##################################### APPLICATION MAIN INIT METHODS #####################################
@@ -669,7 +1213,64 @@ uint32 user_iram_memory_is_enabled(void)
 
 void ICACHE_FLASH_ATTR user_pre_init(void)
 {
-	system_partition_table_regist(part_table, 3, SPI_FLASH_SIZE_MAP);
+	system_partition_table_regist(part_table, sizeof(part_table) / sizeof(partition_item_t), SPI_FLASH_SIZE_MAP);
+}
+
+// Checks whether runtime config describes the same routes and query plan layout as built-in tables
+static bool is_config_layout_matching(const struct config_record* config)
+{
+	uint8 i;
+	if (config->routes_count != ROUTE_COUNT || config->queries_count != QUERY_PLAN_SIZE)
+	{
+		return false;
+	}
+	for (i = 0; i < ROUTE_COUNT; ++i)
+	{
+		if (config->routes[i].query_idx != ROUTES[i].query_idx ||
+				config->routes[i].origin_idx != ROUTES[i].origin_idx ||
+				config->routes[i].destination_idx != ROUTES[i].destination_idx)
+		{
+			return false;
+		}
+	}
+	for (i = 0; i < QUERY_PLAN_SIZE; ++i)
+	{
+		if (config->queries[i].type != QUERY_PLAN[i].type ||
+				config->queries[i].route_idx != QUERY_PLAN[i].route_idx ||
+				config->queries[i].leg_idx != QUERY_PLAN[i].leg_idx)
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+// Runtime config record (read once from flash) overrides built-in WiFi credentials, API key,
+// route coordinates and thresholds - the number of routes and their batching has to stay the same
+static void load_config(void)
+{
+	os_memcpy(route_table, ROUTES, sizeof(route_table));
+	if (!config_init(CONFIG_PARTITION_ADDR))
+	{
+		OS_UART_LOG("[INFO] No runtime config found, using built-in configuration\n");
+		return;
+	}
+	const struct config_record* config = config_get();
+	OS_UART_LOG("[INFO] Runtime config loaded (sequence: %d)\n", config->sequence);
+	if (!is_config_layout_matching(config))
+	{
+		OS_UART_LOG("[WARNING] Runtime config routes (%d routes, %d queries) do not match firmware, using built-in routes with config API key\n",
+				config->routes_count,
+				config->queries_count);
+		return;
+	}
+	uint8 i;
+	for (i = 0; i < ROUTE_COUNT; ++i)
+	{
+		route_table[i].best_time = config->routes[i].best_time;
+		route_table[i].worst_time = config->routes[i].worst_time;
+	}
+	is_config_routes_active = true;
 }
 
 void on_user_init_completed(void)
@@ -677,9 +1278,52 @@ void on_user_init_completed(void)
 	espconn_secure_set_size(0x01, TLS_HANDSHAKE_BUFFER_SIZE);
 	// SNTP connection initialization (used for TLS shared key generation)
 	sntp_setservername(0, SNTP_URL);
+	sntp_set_timezone(TIMEZONE_OFFSET);
 	sntp_init();
-	os_timer_setfn(&start_timer, (os_timer_func_t*)main_timer_handler, NULL);
-	os_timer_arm(&start_timer, 10, 1);
+	if (LIGHT_SLEEP_MODE)
+	{
+		wifi_set_sleep_type(LIGHT_SLEEP_T);
+	}
+	// each activity wakes CPU up only when it is due
+	sched_init();
+	station_init();
+	http_client_init(HTTP_PARALLEL_CONNECTIONS);
+	conn_task = sched_add("conn", conn_task_handler, NULL, TIMER_PERIOD_CONN);
+	status_task = sched_add("status", status_task_handler, NULL, TIMER_PERIOD_STATUS);
+	route_cycle_task = sched_add("route_cycle", route_cycle_task_handler, NULL, TIMER_PERIOD_ROUTE_CYCLE);
+	initial_query_task = sched_add("initial_query", initial_query_task_handler, NULL, TIMER_PERIOD_INITIAL_QUERY);
+	query_task = sched_add("query", query_task_handler, NULL, 0);
+	sleep_task = sched_add("sleep", sleep_task_handler, NULL, 0);
+	clock_task = sched_add("clock", clock_task_handler, NULL, TIMER_PERIOD_CLOCK);
+	if (TREND_DISPLAY_MODE == TREND_DISPLAY_PREDICTION)
+	{
+		trend_task = sched_add("trend", trend_task_handler, NULL, TIMER_PERIOD_TREND);
+	}
+	wifi_set_event_handler_cb(on_wifi_event_callback);
+	if (STATUS_SERVER_MODE && !status_server_init(STATUS_SERVER_PORT, render_status))
+	{
+		OS_UART_LOG("[ERROR] Unable to start status server on port %d\n", STATUS_SERVER_PORT);
+	}
+	effects_init(GPIO_PIN_LED, true, LED_COUNT);
+	if (is_state_restored)
+	{
+		sched_set_deadline(query_task, restored_refresh_delay);
+		show_routes();
+		// levels are still latched in shift registers after deep sleep - shown frame is not animated from blank bar
+		effects_skip_transition();
+		wake_to_display_time = (uint32)sched_now_ms();
+		OS_UART_LOG("[INFO] Restored levels shown %d ms after wake-up\n", wake_to_display_time);
+		if (DEEP_SLEEP_MODE && restored_refresh_delay / 1000 >= DEEP_SLEEP_MIN_DURATION)
+		{
+			// woken up before planned update (interval exceeds the longest deep sleep) - WiFi is not started
+			deep_sleep_duration = restored_refresh_delay / 1000;
+			sched_set_deadline(sleep_task, 0);
+			return;
+		}
+	}
+	// connect right away rather than at first connection check
+	connect();
+	update_effects();
 }
 
 void ICACHE_FLASH_ATTR user_init(void)
@@ -696,6 +1340,44 @@ void ICACHE_FLASH_ATTR user_init(void)
 	GPIO_OUTPUT_SET(GPIO_PIN_SER_CLOCK, 0);
 	GPIO_OUTPUT_SET(GPIO_PIN_READ_LATCH, 0);
 
+	struct display_config display_config = { DISPLAY_DRIVER, LED_COUNT, GPIO_PIN_SER_DATA, GPIO_PIN_SER_CLOCK, GPIO_PIN_READ_LATCH };
+	display_init(&display_config);
+
+	load_config();
+	clock_init(TIMEZONE_OFFSET);
+	if (clock_get_stats()->source == CLOCK_SOURCE_RESTORED)
+	{
+		OS_UART_LOG("[INFO] Restored clock from RTC memory (%d sec since SNTP sync)\n", clock_get_stats()->restored_age);
+	}
+	uint8 i;
+	for (i = 0; i < ROUTE_COUNT; ++i)
+	{
+		route_durations[i] = -1;
+		trend_init(&route_trends[i]);
+	}
+	for (i = 0; i < LEG_DURATIONS_SIZE; ++i)
+	{
+		leg_durations[i] = -1;
+	}
+
+	// route time change worth a new query - one LED step of the most sensitive route
+	poll_config.min_interval = POLL_INTERVAL_MIN;
+	poll_config.max_interval = POLL_INTERVAL_MAX;
+	poll_config.daily_budget = POLL_DAILY_BUDGET;
+	poll_config.target_change = 0xFFFF;
+	poll_config.windows = POLL_WINDOWS;
+	poll_config.windows_count = sizeof(POLL_WINDOWS) / sizeof(struct poll_window);
+	for (i = 0; i < ROUTE_COUNT; ++i)
+	{
+		uint16 led_step = (route_table[i].worst_time - route_table[i].best_time) / LED_COUNT;
+		poll_config.target_change = led_step < poll_config.target_change ? led_step : poll_config.target_change;
+	}
+	poll_init(&poll_config);
+	restore_display_state();
+
 	wifi_set_opmode(STATION_MODE);
+	// SDK connect at boot (with scan and DHCP) is replaced by connect() once init is completed
+	wifi_station_set_auto_connect(false);
+	wifi_station_set_reconnect_policy(true);
 	system_init_done_cb(on_user_init_completed);
 }
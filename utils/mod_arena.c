@@ -0,0 +1,65 @@
+#include "mod_arena.h"
+
+#include <osapi.h>
+
+// Static bump allocator: memory is never returned to the heap, so repeated queries
+// cannot fragment it. Allocations are released all at once by arena_reset (upon query
+// completion) or in LIFO order for scoped temporaries with arena_mark / arena_release.
+
+static uint32 arena_buffer[ARENA_SIZE / sizeof(uint32)];
+static size_t arena_offset = 0;
+static size_t arena_peak = 0;
+
+void* arena_alloc(size_t size)
+{
+	size_t aligned_size = ARENA_ALIGN(size);
+	if (aligned_size > ARENA_SIZE - arena_offset)
+	{
+		return NULL;
+	}
+	void* result = (uint8*)arena_buffer + arena_offset;
+	arena_offset += aligned_size;
+	if (arena_offset > arena_peak)
+	{
+		arena_peak = arena_offset;
+	}
+	return result;
+}
+
+void* arena_zalloc(size_t size)
+{
+	void* result = arena_alloc(size);
+	if (result)
+	{
+		os_bzero(result, size);
+	}
+	return result;
+}
+
+size_t arena_mark(void)
+{
+	return arena_offset;
+}
+
+void arena_release(size_t mark)
+{
+	if (mark < arena_offset)
+	{
+		arena_offset = mark;
+	}
+}
+
+void arena_reset(void)
+{
+	arena_offset = 0;
+}
+
+size_t arena_used(void)
+{
+	return arena_offset;
+}
+
+size_t arena_high_water(void)
+{
+	return arena_peak;
+}
@@ -0,0 +1,148 @@
+#include "mod_clock.h"
+#include "mod_rtcmem.h"
+
+#include <osapi.h>
+#include <user_interface.h>
+#include <sntp.h>
+#include <version.h>
+
+// Wall clock kept across resets and deep sleep: UTC time is anchored to RTC timer value (with RTC period
+// calibration) and the anchor is stored in RTC memory on each update. At boot the clock is restored from
+// the anchor, so it is usable before SNTP server responds. Application time is always computed from the
+// anchor and RTC timer offset, SDK clock is only followed once SNTP server responds.
+
+// SDK clock (used by TLS) can be set only by lwIP SNTP client hook (SNTP_SET_SYSTEM_TIME): sntp_set_system_time
+// of libsntp.a (sntp.o), not declared by sntp.h. It is verified with NONOS SDK 3.0.x libraries only - with them
+// SDK clock is seeded from restored clock when TLS needs it before SNTP response, other SDKs wait for SNTP server.
+#if defined(ESP_SDK_VERSION_MAJOR) && ESP_SDK_VERSION_MAJOR == 3
+#define CLOCK_SDK_SEEDING
+void sntp_set_system_time(uint32 time);
+#endif
+
+struct clock_record
+{
+	// UTC time at RTC timer value
+	uint32 utc_time;
+	uint32 rtc_time;
+	// RTC timer period (us, Q12 fixed point)
+	uint32 rtc_period;
+	// UTC time of the last SNTP sync
+	uint32 sync_time;
+};
+
+static struct clock_record clock_anchor;
+static struct clock_stats clock_stats;
+static sint32 clock_timezone_offset = 0;
+static bool is_sdk_clock_seeded = false;
+
+// Whole seconds elapsed since anchor, anchor is moved forward by them (fraction of second is kept in RTC ticks)
+static uint32 clock_advance(struct clock_record* anchor)
+{
+	uint32 ticks = system_get_rtc_time() - anchor->rtc_time;
+	uint32 elapsed = (uint32)((((uint64)ticks * anchor->rtc_period) >> 12) / 1000000);
+	anchor->utc_time += elapsed;
+	anchor->rtc_time += (uint32)(((uint64)elapsed * 1000000 << 12) / anchor->rtc_period);
+	return elapsed;
+}
+
+void clock_init(sint8 timezone)
+{
+	struct clock_record record;
+	clock_timezone_offset = timezone * 3600;
+	os_bzero(&clock_anchor, sizeof(struct clock_record));
+	os_bzero(&clock_stats, sizeof(struct clock_stats));
+	is_sdk_clock_seeded = false;
+	// RTC timer restarts after external reset (RTC memory is kept)
+	if (system_get_rst_info()->reason == REASON_EXT_SYS_RST ||
+			!rtcmem_read(RTCMEM_SLOT_CLOCK, &record, sizeof(struct clock_record)) ||
+			record.rtc_period == 0 || record.utc_time < CLOCK_MIN_VALID_TIME)
+	{
+		return;
+	}
+	uint32 ticks = system_get_rtc_time() - record.rtc_time;
+	if (((((uint64)ticks * record.rtc_period) >> 12) / 1000000) > CLOCK_MAX_HOLDOVER)
+	{
+		return;
+	}
+	clock_advance(&record);
+	if (record.utc_time - record.sync_time > CLOCK_MAX_HOLDOVER)
+	{
+		return;
+	}
+	clock_anchor = record;
+	clock_stats.source = CLOCK_SOURCE_RESTORED;
+	clock_stats.restored_age = record.utc_time - record.sync_time;
+}
+
+// Follows SDK clock once SNTP server responds, stores clock anchor into RTC memory
+void clock_update(void)
+{
+	uint32 sdk_time = sntp_get_current_timestamp();
+	uint32 utc_time = sdk_time - clock_timezone_offset;
+	if (sdk_time && utc_time >= CLOCK_MIN_VALID_TIME)
+	{
+		// SDK clock seeded from restored clock runs in step with it until SNTP response corrects it
+		bool is_synced = clock_stats.source != CLOCK_SOURCE_RESTORED || !is_sdk_clock_seeded;
+		if (!is_synced)
+		{
+			clock_advance(&clock_anchor);
+			sint32 deviation = (sint32)(utc_time - clock_anchor.utc_time);
+			is_synced = deviation > CLOCK_SYNC_TOLERANCE || deviation < -CLOCK_SYNC_TOLERANCE;
+		}
+		if (is_synced)
+		{
+			if (!clock_stats.sntp_wait_time)
+			{
+				clock_stats.sntp_wait_time = system_get_time() / 1000;
+			}
+			// SDK clock is kept by SNTP client from now on
+			clock_stats.source = CLOCK_SOURCE_SNTP;
+			clock_anchor.sync_time = utc_time;
+		}
+		clock_anchor.utc_time = utc_time;
+		clock_anchor.rtc_time = system_get_rtc_time();
+		clock_anchor.rtc_period = system_rtc_clock_cali_proc();
+	}
+	else if (clock_stats.source == CLOCK_SOURCE_RESTORED)
+	{
+		clock_advance(&clock_anchor);
+		clock_anchor.rtc_period = system_rtc_clock_cali_proc();
+	}
+	if (clock_stats.source != CLOCK_SOURCE_NONE)
+	{
+		rtcmem_write(RTCMEM_SLOT_CLOCK, &clock_anchor, sizeof(struct clock_record));
+	}
+}
+
+// Readiness gate of time dependent activities (TLS handshake): SDK clock is seeded from restored clock
+// if SNTP server has not responded yet, returns false while SDK clock has no valid time
+bool clock_is_ready(void)
+{
+	clock_update();
+#ifdef CLOCK_SDK_SEEDING
+	if (clock_stats.source == CLOCK_SOURCE_RESTORED && !is_sdk_clock_seeded)
+	{
+		sntp_set_system_time(clock_anchor.utc_time);
+		is_sdk_clock_seeded = true;
+	}
+	return clock_stats.source != CLOCK_SOURCE_NONE;
+#else
+	return clock_stats.source == CLOCK_SOURCE_SNTP;
+#endif
+}
+
+// Local wall clock time (seconds, 0 - no valid time yet)
+uint32 clock_get_local_time(void)
+{
+	if (clock_stats.source == CLOCK_SOURCE_NONE)
+	{
+		return 0;
+	}
+	clock_advance(&clock_anchor);
+	return clock_anchor.utc_time + clock_timezone_offset;
+}
+
+const struct clock_stats* clock_get_stats(void)
+{
+	return &clock_stats;
+}
@@ -0,0 +1,183 @@
+#include "mod_config.h"
+
+#include <osapi.h>
+#include <spi_flash.h>
+
+// CRC is verified by reading record through small stack buffer, so record is never copied
+// to heap and only its header is kept in RAM
+#define CONFIG_CHUNK_SIZE                       64
+#define CONFIG_CRC_OFFSET                       (offsetof(struct config_record, crc) + sizeof(uint32))
+
+// CRC-32 (reflected, polynomial 0xEDB88320) processed by nibbles
+static const uint32 CRC32_NIBBLE_TABLE[] =
+{
+		0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC, 0x76DC4190, 0x6B6B51F4, 0x4DB26158, 0x5005713C,
+		0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C, 0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C
+};
+
+static struct config_record config_record;
+static uint32 config_flash_addr = 0;
+static sint8 config_active_sector = -1;
+
+static uint32 config_crc32(uint32 crc, const uint8* data, size_t len)
+{
+	size_t i;
+	for (i = 0; i < len; ++i)
+	{
+		crc ^= data[i];
+		crc = (crc >> 4) ^ CRC32_NIBBLE_TABLE[crc & 0x0F];
+		crc = (crc >> 4) ^ CRC32_NIBBLE_TABLE[crc & 0x0F];
+	}
+	return crc;
+}
+
+static uint32 config_sector_addr(uint8 sector)
+{
+	return config_flash_addr + sector * CONFIG_SECTOR_SIZE;
+}
+
+// CRC of record part stored after header (URL area), read from flash by chunks
+static bool config_crc32_flash(uint32 addr, uint32 len, uint32* crc)
+{
+	uint32 chunk[CONFIG_CHUNK_SIZE / sizeof(uint32)];
+	uint32 offset;
+	for (offset = 0; offset < len; offset += CONFIG_CHUNK_SIZE)
+	{
+		uint32 chunk_len = len - offset < CONFIG_CHUNK_SIZE ? len - offset : CONFIG_CHUNK_SIZE;
+		if (spi_flash_read(addr + offset, chunk, (chunk_len + 3) & ~3) != SPI_FLASH_RESULT_OK)
+		{
+			return false;
+		}
+		*crc = config_crc32(*crc, (const uint8*)chunk, chunk_len);
+	}
+	return true;
+}
+
+static bool config_is_header_valid(const struct config_record* record)
+{
+	return record->magic == CONFIG_MAGIC &&
+			record->version == CONFIG_VERSION &&
+			record->size >= sizeof(struct config_record) &&
+			record->size <= CONFIG_SECTOR_SIZE &&
+			(record->size & 3) == 0 &&
+			record->routes_count <= CONFIG_MAX_ROUTES &&
+			record->queries_count <= CONFIG_MAX_QUERIES;
+}
+
+// Reads record header into 'output', returns true if the whole record is valid
+static bool config_read_sector(uint8 sector, struct config_record* output)
+{
+	uint32 addr = config_sector_addr(sector);
+	if (spi_flash_read(addr, (uint32*)output, sizeof(struct config_record)) != SPI_FLASH_RESULT_OK ||
+			!config_is_header_valid(output))
+	{
+		return false;
+	}
+	uint32 crc = config_crc32(0xFFFFFFFF,
+			(const uint8*)output + CONFIG_CRC_OFFSET,
+			sizeof(struct config_record) - CONFIG_CRC_OFFSET);
+	if (!config_crc32_flash(addr + sizeof(struct config_record), output->size - sizeof(struct config_record), &crc))
+	{
+		return false;
+	}
+	// strings are always terminated regardless of record content
+	output->wifi_ssid[CONFIG_SSID_SIZE - 1] = '\0';
+	output->wifi_passphrase[CONFIG_PASSPHRASE_SIZE - 1] = '\0';
+	output->api_key[CONFIG_KEY_SIZE - 1] = '\0';
+	return ~crc == output->crc;
+}
+
+// Loads the newest valid record from two flash sectors starting at 'flash_addr' (sector aligned),
+// returns false if none of sectors holds valid record
+bool config_init(uint32 flash_addr)
+{
+	struct config_record candidate;
+	uint8 i;
+	config_flash_addr = flash_addr;
+	config_active_sector = -1;
+	for (i = 0; i < CONFIG_SECTORS_COUNT; ++i)
+	{
+		if (config_read_sector(i, &candidate) &&
+				(config_active_sector < 0 || (sint32)(candidate.sequence - config_record.sequence) > 0))
+		{
+			config_record = candidate;
+			config_active_sector = i;
+		}
+	}
+	return config_active_sector >= 0;
+}
+
+// Active record, NULL if there is no valid record in flash
+const struct config_record* config_get(void)
+{
+	return config_active_sector >= 0 ? &config_record : NULL;
+}
+
+// Reads request URL directly from flash into 'output' (4-byte aligned) and appends API key
+bool config_load_url(uint8 query_idx, char* output, size_t output_size)
+{
+	if (config_active_sector < 0 || query_idx >= config_record.queries_count)
+	{
+		return false;
+	}
+	const struct config_query* query = &config_record.queries[query_idx];
+	uint32 aligned_len = (query->url_len + 3) & ~3;
+	// URL area starts after header, each URL is 4-byte aligned (flash is read by words)
+	if (aligned_len + os_strlen(config_record.api_key) >= output_size ||
+			query->url_offset < sizeof(struct config_record) ||
+			(query->url_offset & 3) != 0 ||
+			query->url_offset + query->url_len > config_record.size ||
+			spi_flash_read(config_sector_addr(config_active_sector) + query->url_offset, (uint32*)output, aligned_len) != SPI_FLASH_RESULT_OK)
+	{
+		return false;
+	}
+	output[query->url_len] = '\0';
+	os_strcat(output, config_record.api_key);
+	return true;
+}
+
+// Writes updated record header (URL area is kept from active record) into inactive sector,
+// record becomes active only once it is completely written
+bool config_save(const struct config_record* record)
+{
+	if (config_active_sector < 0 || record->size != config_record.size)
+	{
+		return false;
+	}
+	uint8 sector = config_active_sector ^ 1;
+	uint32 source_addr = config_sector_addr(config_active_sector);
+	uint32 target_addr = config_sector_addr(sector);
+	struct config_record update = *record;
+	update.magic = CONFIG_MAGIC;
+	update.version = CONFIG_VERSION;
+	update.sequence = config_record.sequence + 1;
+	uint32 crc = config_crc32(0xFFFFFFFF,
+			(const uint8*)&update + CONFIG_CRC_OFFSET,
+			sizeof(struct config_record) - CONFIG_CRC_OFFSET);
+	if (spi_flash_erase_sector(target_addr / CONFIG_SECTOR_SIZE) != SPI_FLASH_RESULT_OK)
+	{
+		return false;
+	}
+	// URL area first, header (with magic) last
+	uint32 chunk[CONFIG_CHUNK_SIZE / sizeof(uint32)];
+	uint32 offset;
+	for (offset = sizeof(struct config_record); offset < update.size; offset += CONFIG_CHUNK_SIZE)
+	{
+		uint32 chunk_len = update.size - offset < CONFIG_CHUNK_SIZE ? update.size - offset : CONFIG_CHUNK_SIZE;
+		uint32 aligned_len = (chunk_len + 3) & ~3;
+		if (spi_flash_read(source_addr + offset, chunk, aligned_len) != SPI_FLASH_RESULT_OK ||
+				spi_flash_write(target_addr + offset, chunk, aligned_len) != SPI_FLASH_RESULT_OK)
+		{
+			return false;
+		}
+		crc = config_crc32(crc, (const uint8*)chunk, chunk_len);
+	}
+	update.crc = ~crc;
+	if (spi_flash_write(target_addr, (uint32*)&update, sizeof(struct config_record)) != SPI_FLASH_RESULT_OK)
+	{
+		return false;
+	}
+	config_record = update;
+	config_active_sector = sector;
+	return true;
+}
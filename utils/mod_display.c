@@ -0,0 +1,183 @@
+#include "mod_display.h"
+
+#include <osapi.h>
+#include <gpio.h>
+#include <eagle_soc.h>
+
+// Framebuffer of daisy-chained 74HC595 shift registers: LED 'i' is bit (i % 8) of byte (i / 8),
+// LEDs are shifted out starting from LED 0. Frame is pushed out only when it differs from the
+// one currently latched, without busy-wait delays (each peripheral register write already takes
+// longer than 74HC595 setup / pulse width times).
+
+// HSPI peripheral registers (SPI1)
+#define DISPLAY_HSPI_BASE                       0x60000100
+#define DISPLAY_HSPI_CMD                        (DISPLAY_HSPI_BASE + 0x00)
+#define DISPLAY_HSPI_CTRL                       (DISPLAY_HSPI_BASE + 0x08)
+#define DISPLAY_HSPI_CLOCK                      (DISPLAY_HSPI_BASE + 0x18)
+#define DISPLAY_HSPI_USER                       (DISPLAY_HSPI_BASE + 0x1C)
+#define DISPLAY_HSPI_USER1                      (DISPLAY_HSPI_BASE + 0x20)
+#define DISPLAY_HSPI_W0                         (DISPLAY_HSPI_BASE + 0x40)
+
+#define DISPLAY_HSPI_CMD_USR                    BIT(18)
+#define DISPLAY_HSPI_CTRL_WR_BIT_ORDER          BIT(26)
+#define DISPLAY_HSPI_USER_COMMAND               BIT(31)
+#define DISPLAY_HSPI_USER_ADDR                  BIT(30)
+#define DISPLAY_HSPI_USER_DUMMY                 BIT(29)
+#define DISPLAY_HSPI_USER_MISO                  BIT(28)
+#define DISPLAY_HSPI_USER_MOSI                  BIT(27)
+#define DISPLAY_HSPI_USER1_MOSI_BITLEN_SHIFT    17
+#define DISPLAY_HSPI_USER1_MOSI_BITLEN_MASK     0x1FF
+// HSPI clock is derived from 80 MHz APB clock rather than system clock
+#define DISPLAY_IO_MUX_HSPI_CLOCK               0x105
+
+static struct display_config display_config;
+static struct display_stats display_stats;
+static uint8 display_frame[DISPLAY_FRAME_SIZE];
+static uint8 display_latched[DISPLAY_FRAME_SIZE];
+static bool is_latched_valid = false;
+
+static void display_latch(void)
+{
+	GPIO_REG_WRITE(GPIO_OUT_W1TS_ADDRESS, BIT(display_config.latch_pin));
+	GPIO_REG_WRITE(GPIO_OUT_W1TC_ADDRESS, BIT(display_config.latch_pin));
+}
+
+static void display_push_gpio(void)
+{
+	uint32 data_mask = BIT(display_config.data_pin);
+	uint32 clock_mask = BIT(display_config.clock_pin);
+	uint16 i;
+	for (i = 0; i < display_config.led_count; ++i)
+	{
+		bool is_on = (display_frame[i / 8] >> (i % 8)) & 1;
+		GPIO_REG_WRITE(is_on ? GPIO_OUT_W1TS_ADDRESS : GPIO_OUT_W1TC_ADDRESS, data_mask);
+		GPIO_REG_WRITE(GPIO_OUT_W1TS_ADDRESS, clock_mask);
+		GPIO_REG_WRITE(GPIO_OUT_W1TC_ADDRESS, clock_mask);
+	}
+	display_latch();
+}
+
+// Whole frame is sent as a single HSPI transaction (LSB first, byte 0 first)
+static void display_push_hspi(void)
+{
+	uint8 i;
+	while (READ_PERI_REG(DISPLAY_HSPI_CMD) & DISPLAY_HSPI_CMD_USR)
+	{
+	}
+	for (i = 0; i < DISPLAY_FRAME_SIZE / 4; ++i)
+	{
+		uint32 word = display_frame[i * 4] |
+				(display_frame[i * 4 + 1] << 8) |
+				(display_frame[i * 4 + 2] << 16) |
+				(display_frame[i * 4 + 3] << 24);
+		WRITE_PERI_REG(DISPLAY_HSPI_W0 + i * 4, word);
+	}
+	SET_PERI_REG_BITS(DISPLAY_HSPI_USER1,
+			DISPLAY_HSPI_USER1_MOSI_BITLEN_MASK,
+			display_config.led_count - 1,
+			DISPLAY_HSPI_USER1_MOSI_BITLEN_SHIFT);
+	SET_PERI_REG_MASK(DISPLAY_HSPI_CMD, DISPLAY_HSPI_CMD_USR);
+	// transfer of up to 64 bits at 5 MHz takes about 13 us
+	while (READ_PERI_REG(DISPLAY_HSPI_CMD) & DISPLAY_HSPI_CMD_USR)
+	{
+	}
+	display_latch();
+}
+
+static void display_init_hspi(void)
+{
+	WRITE_PERI_REG(PERIPHS_IO_MUX, DISPLAY_IO_MUX_HSPI_CLOCK);
+	PIN_FUNC_SELECT(PERIPHS_IO_MUX_MTCK_U, FUNC_HSPID_MOSI);
+	PIN_FUNC_SELECT(PERIPHS_IO_MUX_MTMS_U, FUNC_HSPI_CLK);
+	// pre-divider, divider, clock high and low phase lengths
+	WRITE_PERI_REG(DISPLAY_HSPI_CLOCK,
+			((DISPLAY_HSPI_CLOCK_PREDIV - 1) << 18) |
+			((DISPLAY_HSPI_CLOCK_DIV - 1) << 12) |
+			((DISPLAY_HSPI_CLOCK_DIV / 2 - 1) << 6) |
+			(DISPLAY_HSPI_CLOCK_DIV - 1));
+	SET_PERI_REG_MASK(DISPLAY_HSPI_CTRL, DISPLAY_HSPI_CTRL_WR_BIT_ORDER);
+	CLEAR_PERI_REG_MASK(DISPLAY_HSPI_USER,
+			DISPLAY_HSPI_USER_COMMAND | DISPLAY_HSPI_USER_ADDR | DISPLAY_HSPI_USER_DUMMY | DISPLAY_HSPI_USER_MISO);
+	SET_PERI_REG_MASK(DISPLAY_HSPI_USER, DISPLAY_HSPI_USER_MOSI);
+}
+
+void display_init(const struct display_config* config)
+{
+	display_config = *config;
+	if (display_config.led_count > DISPLAY_MAX_LEDS)
+	{
+		display_config.led_count = DISPLAY_MAX_LEDS;
+	}
+	os_bzero(&display_stats, sizeof(struct display_stats));
+	os_bzero(display_frame, sizeof(display_frame));
+	is_latched_valid = false;
+	GPIO_REG_WRITE(GPIO_ENABLE_W1TS_ADDRESS, BIT(display_config.latch_pin));
+	GPIO_REG_WRITE(GPIO_OUT_W1TC_ADDRESS, BIT(display_config.latch_pin));
+	if (display_config.driver == DISPLAY_DRIVER_HSPI)
+	{
+		display_init_hspi();
+	}
+	else
+	{
+		uint32 mask = BIT(display_config.data_pin) | BIT(display_config.clock_pin);
+		GPIO_REG_WRITE(GPIO_ENABLE_W1TS_ADDRESS, mask);
+		GPIO_REG_WRITE(GPIO_OUT_W1TC_ADDRESS, mask);
+	}
+}
+
+void display_clear(void)
+{
+	os_bzero(display_frame, sizeof(display_frame));
+}
+
+void display_set(uint16 led, bool is_on)
+{
+	if (led >= display_config.led_count)
+	{
+		return;
+	}
+	if (is_on)
+	{
+		display_frame[led / 8] |= (1 << (led % 8));
+	}
+	else
+	{
+		display_frame[led / 8] &= ~(1 << (led % 8));
+	}
+}
+
+void display_fill(uint16 first_led, uint16 count, bool is_on)
+{
+	uint16 i;
+	for (i = first_led; i < first_led + count; ++i)
+	{
+		display_set(i, is_on);
+	}
+}
+
+// Pushes frame out to shift registers, returns false if frame has not changed since last push
+bool display_flush(void)
+{
+	if (is_latched_valid && os_memcmp(display_frame, display_latched, sizeof(display_frame)) == 0)
+	{
+		++display_stats.frames_skipped;
+		return false;
+	}
+	if (display_config.driver == DISPLAY_DRIVER_HSPI)
+	{
+		display_push_hspi();
+	}
+	else
+	{
+		display_push_gpio();
+	}
+	os_memcpy(display_latched, display_frame, sizeof(display_frame));
+	is_latched_valid = true;
+	++display_stats.frames_pushed;
+	return true;
+}
+
+const struct display_stats* display_get_stats(void)
+{
+	return &display_stats;
+}
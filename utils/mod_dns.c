@@ -0,0 +1,85 @@
+#include "mod_dns.h"
+
+#include <osapi.h>
+
+static struct dns_cache_entry dns_cache[DNS_CACHE_SIZE];
+static struct dns_cache_stats dns_stats;
+
+static struct dns_cache_entry* dns_cache_find(const char* hostname)
+{
+	uint8 i;
+	for (i = 0; i < DNS_CACHE_SIZE; ++i)
+	{
+		if (dns_cache[i].is_valid && os_strcmp(dns_cache[i].hostname, hostname) == 0)
+		{
+			return &dns_cache[i];
+		}
+	}
+	return NULL;
+}
+
+// Looks up non-expired address by hostname ('now' - monotonic time in seconds)
+bool dns_cache_lookup(const char* hostname, uint32 now, uint32* output_addr)
+{
+	struct dns_cache_entry* entry = dns_cache_find(hostname);
+	if (entry && (sint32)(entry->expiry_time - now) > 0)
+	{
+		*output_addr = entry->addr;
+		++dns_stats.hits;
+		return true;
+	}
+	if (entry)
+	{
+		entry->is_valid = false;
+	}
+	++dns_stats.misses;
+	return false;
+}
+
+void dns_cache_store(const char* hostname, uint32 addr, uint32 ttl, uint32 now)
+{
+	if (os_strlen(hostname) >= DNS_CACHE_HOSTNAME_SIZE)
+	{
+		return;
+	}
+	struct dns_cache_entry* entry = dns_cache_find(hostname);
+	uint8 i;
+	for (i = 0; i < DNS_CACHE_SIZE && !entry; ++i)
+	{
+		if (!dns_cache[i].is_valid)
+		{
+			entry = &dns_cache[i];
+		}
+	}
+	if (!entry)
+	{
+		// cache is full - replacing entry which expires first
+		entry = &dns_cache[0];
+		for (i = 1; i < DNS_CACHE_SIZE; ++i)
+		{
+			if ((sint32)(dns_cache[i].expiry_time - entry->expiry_time) < 0)
+			{
+				entry = &dns_cache[i];
+			}
+		}
+	}
+	os_strcpy(entry->hostname, hostname);
+	entry->addr = addr;
+	entry->expiry_time = now + ttl;
+	entry->is_valid = true;
+}
+
+void dns_cache_invalidate(const char* hostname)
+{
+	struct dns_cache_entry* entry = dns_cache_find(hostname);
+	if (entry)
+	{
+		entry->is_valid = false;
+		++dns_stats.invalidations;
+	}
+}
+
+const struct dns_cache_stats* dns_cache_get_stats(void)
+{
+	return &dns_stats;
+}
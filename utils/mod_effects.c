@@ -0,0 +1,211 @@
+#include "mod_effects.h"
+#include "mod_display.h"
+#include "mod_sched.h"
+
+#include <osapi.h>
+#include <gpio.h>
+
+// LED effects engine: each channel (status LED, LED bar) plays one effect - a table of steps
+// advanced by one-shot scheduler task, so effects never busy-wait inside timer callbacks.
+
+struct effect_channel
+{
+	const struct effect* effect;
+	uint8 step_idx;
+	sint8 task_id;
+};
+
+static struct effect_channel effect_channels[EFFECT_CHANNELS_COUNT];
+static uint8 effects_status_pin = 0;
+static bool is_effects_status_active_low = false;
+static uint16 effects_led_count = 0;
+// shown and target bar segment levels (level transitions)
+static uint16 shown_levels[EFFECT_MAX_SEGMENTS];
+static uint16 target_levels[EFFECT_MAX_SEGMENTS];
+// trend marker direction of each segment (-1 falling, 0 none, 1 rising)
+static sint8 marker_directions[EFFECT_MAX_SEGMENTS];
+static uint8 segments_count = 0;
+static uint16 segment_size = 0;
+
+static void effects_render_levels(bool is_marker_on)
+{
+	uint8 i;
+	display_clear();
+	for (i = 0; i < segments_count; ++i)
+	{
+		uint16 first_led = i * segment_size;
+		display_fill(first_led, shown_levels[i], true);
+		if (!is_marker_on)
+		{
+			continue;
+		}
+		if (marker_directions[i] > 0 && shown_levels[i] < segment_size)
+		{
+			display_set(first_led + shown_levels[i], true);
+		}
+		else if (marker_directions[i] < 0 && shown_levels[i] > 0)
+		{
+			display_set(first_led + shown_levels[i] - 1, false);
+		}
+	}
+	display_flush();
+}
+
+// Moves each shown level one LED towards its target, returns true once all targets are reached
+static bool effects_step_levels(void)
+{
+	bool is_reached = true;
+	uint8 i;
+	for (i = 0; i < segments_count; ++i)
+	{
+		if (shown_levels[i] < target_levels[i])
+		{
+			++shown_levels[i];
+		}
+		else if (shown_levels[i] > target_levels[i])
+		{
+			--shown_levels[i];
+		}
+		is_reached &= (shown_levels[i] == target_levels[i]);
+	}
+	effects_render_levels(false);
+	return is_reached;
+}
+
+// Applies step operation, returns false if the same step needs to be repeated
+static bool effects_apply(const struct effect_step* step)
+{
+	uint16 i;
+	switch (step->op)
+	{
+		case EFFECT_OP_STATUS:
+			GPIO_OUTPUT_SET(effects_status_pin, (step->arg != 0) != is_effects_status_active_low);
+			break;
+		case EFFECT_OP_BAR_CLEAR:
+			display_clear();
+			display_flush();
+			break;
+		case EFFECT_OP_BAR_LED:
+			display_clear();
+			display_set(effects_led_count - 1 - step->arg, true);
+			display_flush();
+			break;
+		case EFFECT_OP_BAR_PATTERN:
+			for (i = 0; i < effects_led_count; ++i)
+			{
+				display_set(i, (step->arg >> (i % 8)) & 1);
+			}
+			display_flush();
+			break;
+		case EFFECT_OP_BAR_LEVELS:
+			return effects_step_levels();
+		case EFFECT_OP_BAR_MARKERS:
+			effects_render_levels(step->arg != 0);
+			break;
+	}
+	return true;
+}
+
+static void effects_task_handler(void* arg)
+{
+	struct effect_channel* channel = (struct effect_channel*)arg;
+	const struct effect* effect = channel->effect;
+	if (!effect)
+	{
+		return;
+	}
+	const struct effect_step* step = &effect->steps[channel->step_idx];
+	bool is_step_completed = effects_apply(step);
+	if (is_step_completed)
+	{
+		if (channel->step_idx + 1 < effect->steps_count)
+		{
+			++channel->step_idx;
+		}
+		else if (effect->is_looped)
+		{
+			channel->step_idx = 0;
+		}
+		else
+		{
+			// effect completed - channel stays idle until next effect is played
+			return;
+		}
+	}
+	sched_set_deadline(channel->task_id, step->duration);
+}
+
+void effects_init(uint8 status_pin, bool is_status_active_low, uint16 led_count)
+{
+	effects_status_pin = status_pin;
+	is_effects_status_active_low = is_status_active_low;
+	effects_led_count = led_count;
+	os_bzero(effect_channels, sizeof(effect_channels));
+	os_bzero(shown_levels, sizeof(shown_levels));
+	os_bzero(target_levels, sizeof(target_levels));
+	os_bzero(marker_directions, sizeof(marker_directions));
+	segments_count = 0;
+	effect_channels[EFFECT_CHANNEL_STATUS].task_id = sched_add("fx_status", effects_task_handler, &effect_channels[EFFECT_CHANNEL_STATUS], 0);
+	effect_channels[EFFECT_CHANNEL_BAR].task_id = sched_add("fx_bar", effects_task_handler, &effect_channels[EFFECT_CHANNEL_BAR], 0);
+}
+
+// Starts effect on channel (effect which is already playing is not restarted)
+void effects_play(uint8 channel_idx, const struct effect* effect)
+{
+	struct effect_channel* channel = &effect_channels[channel_idx];
+	if (channel->effect == effect)
+	{
+		return;
+	}
+	channel->effect = effect;
+	channel->step_idx = 0;
+	if (effect)
+	{
+		sched_set_deadline(channel->task_id, 0);
+	}
+	else
+	{
+		sched_cancel(channel->task_id);
+	}
+}
+
+// Sets target levels of bar segments - bar effect is restarted to transition towards them
+void effects_set_levels(const uint16* levels, uint8 count, uint16 size)
+{
+	if (count > EFFECT_MAX_SEGMENTS)
+	{
+		count = EFFECT_MAX_SEGMENTS;
+	}
+	if (count != segments_count || size != segment_size)
+	{
+		os_bzero(shown_levels, sizeof(shown_levels));
+		segments_count = count;
+		segment_size = size;
+	}
+	os_memcpy(target_levels, levels, count * sizeof(uint16));
+	struct effect_channel* channel = &effect_channels[EFFECT_CHANNEL_BAR];
+	if (channel->effect)
+	{
+		channel->step_idx = 0;
+		sched_set_deadline(channel->task_id, 0);
+	}
+}
+
+// Shows target levels right away (e.g. levels restored after reset, or before entering deep sleep)
+void effects_skip_transition(void)
+{
+	os_memcpy(shown_levels, target_levels, sizeof(shown_levels));
+	effects_render_levels(false);
+}
+
+// Sets trend marker direction of bar segments (shown by EFFECT_OP_BAR_MARKERS steps)
+void effects_set_markers(const sint8* directions, uint8 count)
+{
+	os_bzero(marker_directions, sizeof(marker_directions));
+	os_memcpy(marker_directions, directions, (count < EFFECT_MAX_SEGMENTS ? count : EFFECT_MAX_SEGMENTS) * sizeof(sint8));
+}
+
+const struct effect* effects_current(uint8 channel)
+{
+	return effect_channels[channel].effect;
+}
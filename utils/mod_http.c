@@ -3,179 +3,426 @@
 #include <osapi.h>
 #include <mem.h>
 
-int parse_url(const char* const input_url, char* output_hostname, char* output_path)
+// Splits URL into hostname and path (at most 'hostname_size' / 'path_size' bytes including terminating zero),
+// URL which does not fit is rejected with HTTP_URL_INVALID
+int parse_url(const char* const input_url, char* output_hostname, size_t hostname_size, char* output_path, size_t path_size)
 {
-	char* local_str = (char*)os_malloc(HTTP_HEADER_BUFFER_SIZE);
-	os_strcpy(local_str, input_url);
 	int prefix_type = HTTP_URL_HTTP;
-
-	char* pch = local_str;
-	if (os_strstr(pch, HTTPS_PATH_PREFIX))
+	const char* pch = input_url;
+	if (os_strncmp(pch, HTTPS_PATH_PREFIX, os_strlen(HTTPS_PATH_PREFIX)) == 0)
 	{
 		pch += os_strlen(HTTPS_PATH_PREFIX);
 		prefix_type = HTTP_URL_HTTPS;
 	}
-	else if (os_strstr(pch, HTTP_PATH_PREFIX))
+	else if (os_strncmp(pch, HTTP_PATH_PREFIX, os_strlen(HTTP_PATH_PREFIX)) == 0)
 	{
 		pch += os_strlen(HTTP_PATH_PREFIX);
 	}
 
-	char* delim = os_strstr(pch, "/");
-	if (delim)
+	const char* delim = os_strchr(pch, '/');
+	size_t hostname_len = delim ? (size_t)(delim - pch) : os_strlen(pch);
+	size_t path_len = delim ? os_strlen(delim) : 1;
+	if (hostname_len >= hostname_size || path_len >= path_size)
 	{
-		os_strcpy(output_path, delim);
-		delim[0] = 0;
+		return HTTP_URL_INVALID;
 	}
-	else
+	os_memcpy(output_hostname, pch, hostname_len);
+	output_hostname[hostname_len] = 0;
+	os_memcpy(output_path, delim ? delim : "/", path_len);
+	output_path[path_len] = 0;
+	return prefix_type;
+}
+
+// ******************************** ZERO-COPY BODY VIEW ********************************
+
+static const char* find_sequence(const char* begin, const char* end, const char* sequence)
+{
+	size_t sequence_len = os_strlen(sequence);
+	const char* p;
+	for (p = begin; p + sequence_len <= end; ++p)
 	{
-		os_strcpy(output_path, "/");
+		if (*p == sequence[0] && os_memcmp(p, sequence, sequence_len) == 0)
+		{
+			return p;
+		}
 	}
-	os_strcpy(output_hostname, pch);
-	os_free(local_str);
-	return prefix_type;
+	return NULL;
 }
 
-void parse_http_headers(const char* input_http_response, char* output_headers)
+// Looks up header value within headers block without copying, returns value length or -1 if header is missing
+static int find_header_value(const char* headers, const char* headers_end, const char* header_name, const char** output_value)
 {
-	output_headers[0] = 0;
-	char* pdelim = os_strstr(input_http_response, HTTP_HEADERS_DELIM);
-	if (pdelim)
+	size_t name_len = os_strlen(header_name);
+	const char* line = find_sequence(headers, headers_end, HTTP_HEADERS_NL);
+	while (line && line < headers_end)
 	{
-		size_t sz_headers_block = pdelim + os_strlen(HTTP_HEADERS_NL) - input_http_response;
-		os_memcpy(output_headers, input_http_response, sz_headers_block);
-		output_headers[sz_headers_block] = 0;
+		line += os_strlen(HTTP_HEADERS_NL);
+		const char* line_end = find_sequence(line, headers_end, HTTP_HEADERS_NL);
+		if (!line_end)
+		{
+			line_end = headers_end;
+		}
+		if (line + name_len < line_end && line[name_len] == ':' && strncasecmp(line, header_name, name_len) == 0)
+		{
+			const char* value = line + name_len + 1;
+			while (value < line_end && (*value == ' ' || *value == '\t'))
+			{
+				++value;
+			}
+			*output_value = value;
+			return line_end - value;
+		}
+		line = line_end;
 	}
+	return -1;
 }
 
-void parse_http_header(const char* headers, const char* header_name, char* output_header_value)
+// Parses number of up to 'max_value' (value is never accumulated past it), returns -1 if number is greater
+static long int parse_number(const char* begin, const char* end, int base, long int max_value, const char** output_end)
 {
-	output_header_value[0] = 0;
-	char* search_pattern = (char*)os_malloc(HTTP_HEADER_BUFFER_SIZE);
-	os_sprintf(search_pattern, "%s%s: ", HTTP_HEADERS_NL, header_name);
-	char* phead = strcasestr(headers, search_pattern);
-	if (phead)
+	long int result = 0;
+	const char* p = begin;
+	while (p < end)
 	{
-		char* phead_val = phead + os_strlen(search_pattern);
-		char* phead_end = os_strstr(phead_val, HTTP_HEADERS_NL);
-		if (phead_end)
+		int digit;
+		if (*p >= '0' && *p <= '9')
+		{
+			digit = *p - '0';
+		}
+		else if (base == 16 && *p >= 'a' && *p <= 'f')
 		{
-			os_memcpy(output_header_value, phead_val, phead_end - phead_val);
-			output_header_value[phead_end - phead_val] = 0;
+			digit = *p - 'a' + 10;
 		}
+		else if (base == 16 && *p >= 'A' && *p <= 'F')
+		{
+			digit = *p - 'A' + 10;
+		}
+		else
+		{
+			break;
+		}
+		if (result > max_value / base || result * base > max_value - digit)
+		{
+			*output_end = p;
+			return -1;
+		}
+		result = result * base + digit;
+		++p;
 	}
-	os_free(search_pattern);
+	*output_end = p;
+	return result;
 }
 
-bool is_end_of_content(const char* input_content)
+// Provides decoded body as (pointer, length) view into the response buffer.
+// Chunked body is de-chunked in place by compacting chunk payloads over chunk-size lines,
+// so neither allocation nor extra copy is required. Response buffer is modified in this case.
+int http_body_view(char* http_response, size_t http_response_len, char** output_body, size_t* output_body_len)
 {
-	bool result = false;
-	char* headers = (char*)os_malloc(HTTP_HEADERS_BUFFER_SIZE);
-	parse_http_headers(input_content, headers);
-	if (os_strlen(headers) > 0)
-	{
-		char* header_value = (char*)os_malloc(HTTP_HEADER_BUFFER_SIZE);
-		parse_http_header(headers, HTTP_HEADERS_TRANSFER_ENCODING, header_value);
-		const char* raw_body = &input_content[os_strlen(headers) + os_strlen(HTTP_HEADERS_NL)];
-		if (os_strlen(header_value) > 0)
-		{
-			char* block_start;
-			const char* block_end = raw_body;
-			long int block_sz = strtol(raw_body, &block_start, 16);
-			if (block_sz > 0 && os_strstr(block_start, HTTP_HEADERS_NL) == block_start)
-			{
-				bool overrun_content = false;
-				while (block_sz > 0 && !overrun_content)
-				{
-					block_start += os_strlen(HTTP_HEADERS_NL);
-					block_end = block_start + block_sz;
-					overrun_content = ((block_end - raw_body) + os_strlen(HTTP_HEADERS_NL) > os_strlen(raw_body)) || os_strstr(block_end, HTTP_HEADERS_NL) != block_end;
-					if (!overrun_content)
-					{
-						block_sz = strtol(block_end + os_strlen(HTTP_HEADERS_NL), &block_start, 16);
-					}
-				}
-				result = (block_sz == 0);
+	char* const end = http_response + http_response_len;
+	const char* headers_end = find_sequence(http_response, end, HTTP_HEADERS_DELIM);
+	*output_body = NULL;
+	*output_body_len = 0;
+	if (!headers_end)
+	{
+		return HTTP_PARSE_ERROR_HEADERS;
+	}
+	headers_end += os_strlen(HTTP_HEADERS_NL);
+	char* raw_body = http_response + (headers_end - http_response) + os_strlen(HTTP_HEADERS_NL);
+	const char* header_value;
+	int header_len = find_header_value(http_response, headers_end, HTTP_HEADERS_TRANSFER_ENCODING, &header_value);
+	if (header_len >= 0 && find_sequence(header_value, header_value + header_len, HTTP_TRANSFER_ENCODING_CHUNKED))
+	{
+		const char* read_pos = raw_body;
+		char* write_pos = raw_body;
+		while (true)
+		{
+			const char* size_end;
+			long int block_sz = parse_number(read_pos, end, 16, end - read_pos, &size_end);
+			const char* block_start = size_end < end ? find_sequence(size_end, end, HTTP_HEADERS_NL) : NULL;
+			if (size_end == read_pos || block_sz < 0 || !block_start)
+			{
+				return HTTP_PARSE_ERROR_BLOCK_LENGTH;
+			}
+			if (block_sz == 0)
+			{
+				break;
 			}
+			block_start += os_strlen(HTTP_HEADERS_NL);
+			// chunk data has to be followed by CRLF
+			if (block_sz + (long int)os_strlen(HTTP_HEADERS_NL) > end - block_start ||
+					os_memcmp(block_start + block_sz, HTTP_HEADERS_NL, os_strlen(HTTP_HEADERS_NL)) != 0)
+			{
+				return HTTP_PARSE_ERROR_BLOCK_LENGTH;
+			}
+			os_memmove(write_pos, block_start, block_sz);
+			write_pos += block_sz;
+			read_pos = block_start + block_sz + os_strlen(HTTP_HEADERS_NL);
 		}
-		else
+		// at least one chunk-size line has been dropped - there is always room for terminating zero
+		*write_pos = 0;
+		*output_body = raw_body;
+		*output_body_len = write_pos - raw_body;
+		return HTTP_PARSE_OK;
+	}
+	header_len = find_header_value(http_response, headers_end, HTTP_HEADERS_CONTENT_LENGTH, &header_value);
+	if (header_len > 0)
+	{
+		const char* value_end;
+		long int content_sz = parse_number(header_value, header_value + header_len, 10, end - raw_body, &value_end);
+		if (value_end != header_value && content_sz >= 0)
+		{
+			*output_body = raw_body;
+			*output_body_len = content_sz;
+			return HTTP_PARSE_OK;
+		}
+	}
+	return HTTP_PARSE_ERROR_CONTENT_LENGTH;
+}
+
+// ******************************** INCREMENTAL RESPONSE PARSER ********************************
+
+static void http_parser_fail(struct http_response_parser* parser, sint8 error)
+{
+	parser->error = error;
+	parser->state = HTTP_STATE_ERROR;
+}
+
+static void http_parser_on_header(struct http_response_parser* parser)
+{
+	char* line = parser->line;
+	char* delim = os_strchr(line, ':');
+	if (delim)
+	{
+		size_t name_len = delim - line;
+		char* value = delim + 1;
+		while (*value == ' ' || *value == '\t')
+		{
+			++value;
+		}
+		if (name_len == os_strlen(HTTP_HEADERS_TRANSFER_ENCODING) && strncasecmp(line, HTTP_HEADERS_TRANSFER_ENCODING, name_len) == 0)
+		{
+			parser->is_chunked = (strcasestr(value, HTTP_TRANSFER_ENCODING_CHUNKED) != NULL);
+		}
+		else if (name_len == os_strlen(HTTP_HEADERS_CONTENT_LENGTH) && strncasecmp(line, HTTP_HEADERS_CONTENT_LENGTH, name_len) == 0)
 		{
-			parse_http_header(headers, HTTP_HEADERS_CONTENT_LENGTH, header_value);
-			if (os_strlen(header_value) > 0)
+			const char* line_end = line + parser->line_len;
+			const char* value_end;
+			long int content_sz = parse_number(value, line_end, 10, HTTP_CONTENT_LENGTH_MAX, &value_end);
+			bool is_valid = (content_sz >= 0 && value_end != value);
+			while (value_end < line_end && (*value_end == ' ' || *value_end == '\t'))
 			{
-				long int content_sz = strtol(header_value, NULL, 10);
-				if (content_sz > 0)
-				{
-					result = (content_sz <= os_strlen(raw_body));
-				}
-				else
-				{
-					// Error case: Invalid Content-Length HTTP header value
-					result = true;
-				}
+				++value_end;
+			}
+			if (!is_valid || value_end != line_end)
+			{
+				// Error case: Invalid Content-Length HTTP header value (body end cannot be told)
+				http_parser_fail(parser, HTTP_PARSE_ERROR_CONTENT_LENGTH);
+				return;
+			}
+			parser->has_content_length = true;
+			parser->content_length = content_sz;
+		}
+		else if (name_len == os_strlen(HTTP_HEADERS_CONNECTION) && strncasecmp(line, HTTP_HEADERS_CONNECTION, name_len) == 0)
+		{
+			parser->is_connection_close = (strcasestr(value, HTTP_CONNECTION_CLOSE) != NULL);
+		}
+		else if (name_len == os_strlen(HTTP_HEADERS_CONTENT_ENCODING) && strncasecmp(line, HTTP_HEADERS_CONTENT_ENCODING, name_len) == 0)
+		{
+			parser->is_gzip = (strcasestr(value, HTTP_CONTENT_ENCODING_GZIP) != NULL);
+		}
+	}
+}
+
+static void http_parser_on_headers_end(struct http_response_parser* parser)
+{
+	if (parser->status_code < 200)
+	{
+		// interim response (e.g. 100 Continue) is followed by the final one
+		parser->state = HTTP_STATE_STATUS_LINE;
+	}
+	else if (parser->status_code == 204 || parser->status_code == 304)
+	{
+		// responses which never have body, regardless of framing headers
+		parser->state = HTTP_STATE_DONE;
+	}
+	else if (parser->is_chunked)
+	{
+		parser->state = HTTP_STATE_CHUNK_SIZE;
+	}
+	else if (parser->has_content_length)
+	{
+		parser->remaining = parser->content_length;
+		parser->state = parser->remaining > 0 ? HTTP_STATE_BODY : HTTP_STATE_DONE;
+	}
+	else
+	{
+		// neither Content-Length nor chunked encoding: body ends when server closes connection
+		parser->is_connection_close = true;
+		parser->state = HTTP_STATE_BODY_UNTIL_CLOSE;
+	}
+}
+
+static void http_parser_on_line(struct http_response_parser* parser)
+{
+	char* line = parser->line;
+	switch (parser->state)
+	{
+		case HTTP_STATE_STATUS_LINE:
+		{
+			char* pstatus = os_strchr(line, ' ');
+			long int status_code = 0;
+			if (os_strncmp(line, "HTTP/", 5) == 0 && pstatus)
+			{
+				status_code = strtol(pstatus + 1, NULL, 10);
+			}
+			if (status_code > 0)
+			{
+				parser->status_code = status_code;
+				// HTTP/1.0 connections are not persistent by default
+				parser->is_connection_close = (os_strncmp(line, "HTTP/1.0", 8) == 0);
+				parser->state = HTTP_STATE_HEADER_LINE;
+			}
+			else
+			{
+				http_parser_fail(parser, HTTP_PARSE_ERROR_STATUS_LINE);
+			}
+			break;
+		}
+		case HTTP_STATE_HEADER_LINE:
+			if (parser->line_len == 0)
+			{
+				http_parser_on_headers_end(parser);
+			}
+			else
+			{
+				http_parser_on_header(parser);
+			}
+			break;
+		case HTTP_STATE_CHUNK_SIZE:
+		{
+			// hex digits only (no sign, prefix or leading whitespace), optionally followed by chunk extensions
+			const char* line_end = line + parser->line_len;
+			const char* size_end;
+			long int block_sz = parse_number(line, line_end, 16, HTTP_CHUNK_SIZE_MAX, &size_end);
+			const char* extension = size_end;
+			while (extension < line_end && (*extension == ' ' || *extension == '\t'))
+			{
+				++extension;
+			}
+			if (block_sz < 0 || size_end == line || (extension < line_end && *extension != ';'))
+			{
+				http_parser_fail(parser, HTTP_PARSE_ERROR_BLOCK_LENGTH);
+			}
+			else if (block_sz == 0)
+			{
+				parser->state = HTTP_STATE_TRAILER;
 			}
 			else
 			{
-				// Error case: Unable to identify content size
-				result = true;
+				parser->remaining = block_sz;
+				parser->state = HTTP_STATE_CHUNK_DATA;
 			}
+			break;
 		}
-		os_free(header_value);
+		case HTTP_STATE_CHUNK_DATA_END:
+			if (parser->line_len == 0)
+			{
+				parser->state = HTTP_STATE_CHUNK_SIZE;
+			}
+			else
+			{
+				http_parser_fail(parser, HTTP_PARSE_ERROR_BLOCK_LENGTH);
+			}
+			break;
+		case HTTP_STATE_TRAILER:
+			if (parser->line_len == 0)
+			{
+				parser->state = HTTP_STATE_DONE;
+			}
+			break;
 	}
-	os_free(headers);
-	return result;
 }
 
-int parse_http_body(const char* input_http_response, char* output_body)
+void http_parser_init(struct http_response_parser* parser, http_body_callback on_body, void* arg)
 {
-	char* headers = (char*)os_malloc(HTTP_HEADERS_BUFFER_SIZE);
-	output_body[0] = 0;
-	parse_http_headers(input_http_response, headers);
-	if (os_strlen(headers) > 0)
-	{
-		char header_value[HTTP_HEADER_BUFFER_SIZE];
-		parse_http_header(headers, HTTP_HEADERS_TRANSFER_ENCODING, header_value);
-		const char* raw_body = &input_http_response[os_strlen(headers) + os_strlen(HTTP_HEADERS_NL)];
-		if (os_strlen(header_value) > 0)
-		{
-			char* block_start;
-			char* block_end;
-			size_t out_idx = 0;
-			long int block_sz = strtol(raw_body, &block_start, 16);
-			while (block_sz > 0)
-			{
-				block_start += os_strlen(HTTP_HEADERS_NL);
-				block_end = block_start + block_sz;
-				if (block_end - raw_body > os_strlen(raw_body))
-				{
-					os_free(headers);
-					return HTTP_PARSE_ERROR_BLOCK_LENGTH;
-				}
-				os_memcpy(&output_body[out_idx], block_start, block_sz);
-				out_idx += block_sz;
-				block_sz = strtol(block_end + os_strlen(HTTP_HEADERS_NL), &block_start, 16);
+	os_bzero(parser, sizeof(struct http_response_parser));
+	parser->state = HTTP_STATE_STATUS_LINE;
+	parser->error = HTTP_PARSE_OK;
+	parser->on_body = on_body;
+	parser->arg = arg;
+}
+
+int http_parser_feed(struct http_response_parser* parser, const char* data, size_t len)
+{
+	size_t idx = 0;
+	while (idx < len && parser->state < HTTP_STATE_DONE)
+	{
+		if (parser->state == HTTP_STATE_BODY_UNTIL_CLOSE)
+		{
+			if (parser->on_body)
+			{
+				parser->on_body(parser->arg, &data[idx], len - idx);
+			}
+			parser->body_size += len - idx;
+			idx = len;
+		}
+		else if (parser->state == HTTP_STATE_BODY || parser->state == HTTP_STATE_CHUNK_DATA)
+		{
+			size_t block_sz = len - idx;
+			if (block_sz > parser->remaining)
+			{
+				block_sz = parser->remaining;
+			}
+			if (parser->on_body)
+			{
+				parser->on_body(parser->arg, &data[idx], block_sz);
+			}
+			idx += block_sz;
+			parser->remaining -= block_sz;
+			parser->body_size += block_sz;
+			if (parser->remaining == 0)
+			{
+				parser->state = (parser->state == HTTP_STATE_BODY) ? HTTP_STATE_DONE : HTTP_STATE_CHUNK_DATA_END;
 			}
-			output_body[out_idx] = 0;
-			os_free(headers);
-			return HTTP_PARSE_OK;
 		}
 		else
 		{
-			parse_http_header(headers, HTTP_HEADERS_CONTENT_LENGTH, header_value);
-			if (os_strlen(header_value) > 0)
+			// Line-oriented states: status line, headers, chunk sizes and trailers
+			char ch = data[idx++];
+			if (parser->state <= HTTP_STATE_HEADER_LINE)
+			{
+				++parser->header_size;
+			}
+			if (ch == '\n')
 			{
-				long int content_sz = strtol(header_value, NULL, 10);
-				if (content_sz > 0 && content_sz <= os_strlen(raw_body))
+				if (parser->line_len > 0 && parser->line[parser->line_len - 1] == '\r')
 				{
-					os_memcpy(output_body, raw_body, content_sz);
-					output_body[content_sz] = 0;
-					os_free(headers);
-					return HTTP_PARSE_OK;
+					--parser->line_len;
 				}
+				parser->line[parser->line_len] = 0;
+				http_parser_on_line(parser);
+				parser->line_len = 0;
+			}
+			else if (parser->line_len < sizeof(parser->line) - 1)
+			{
+				// too long lines are truncated, only the leading part is relevant
+				parser->line[parser->line_len++] = ch;
 			}
-			os_free(headers);
-			return HTTP_PARSE_ERROR_CONTENT_LENGTH;
 		}
 	}
-	os_free(headers);
-	return HTTP_PARSE_ERROR_HEADERS;
+	return parser->error;
+}
+
+bool http_parser_is_complete(const struct http_response_parser* parser)
+{
+	return parser->state >= HTTP_STATE_DONE;
+}
+
+// Connection is closed by server: completes body delimited by connection close (other unfinished responses stay incomplete)
+void http_parser_finish(struct http_response_parser* parser)
+{
+	if (parser->state == HTTP_STATE_BODY_UNTIL_CLOSE)
+	{
+		parser->state = HTTP_STATE_DONE;
+	}
 }
@@ -0,0 +1,525 @@
+#include "mod_http_client.h"
+#include "mod_arena.h"
+#include "mod_dns.h"
+#include "mod_metrics.h"
+#include "mod_sched.h"
+
+#include <osapi.h>
+#include <user_interface.h>
+#include <espconn.h>
+
+// Asynchronous HTTP client: requests are served by a static pool of connections - at most 'max_connections'
+// of them (and a single TLS one) are open at a time, further requests wait in submission order. Each request
+// goes through DNS lookup, connect / handshake and transfer on its own, so independent requests overlap rather
+// than running one after another. Connection kept alive after response serves the next request to the same host.
+// Query metrics phases are shared by all requests, so they describe requests which do not overlap.
+
+#define HTTP_CONNECTION_FREE                    0
+#define HTTP_CONNECTION_RESOLVING               1
+#define HTTP_CONNECTION_CONNECTING              2
+#define HTTP_CONNECTION_OPEN                    3	// request is being served, or idle connection kept alive
+#define HTTP_CONNECTION_CLOSING                 4
+
+struct http_connection
+{
+	struct espconn conn;
+	esp_tcp tcp;
+	ip_addr_t server_ip;
+	uint8 state;
+	bool is_secure;
+	bool is_close_pending;
+	uint32 connect_start_time;
+	// request currently served (NULL - connection is idle)
+	struct http_request* request;
+	// host connection is open to (matched against hostnames of the following requests)
+	char hostname[HTTP_HEADER_BUFFER_SIZE];
+};
+
+static struct http_connection http_connections[HTTP_CLIENT_MAX_CONNECTIONS];
+static uint8 http_max_connections = HTTP_CLIENT_MAX_CONNECTIONS;
+// requests waiting for connection (singly-linked, in submission order)
+static struct http_request* http_queue = NULL;
+static struct http_client_stats http_stats;
+static sint8 close_task = SCHED_INVALID_TASK;
+
+static void http_client_dispatch(void);
+static void http_client_on_dns_resolved(const char* hostname, ip_addr_t* ip, void* arg);
+static void http_client_on_connected(void* arg);
+static void http_client_on_receive(void* arg, char* data, unsigned short len);
+static void http_client_on_closed(void* arg);
+static void http_client_on_failed(void* arg, sint8 error);
+
+static struct http_connection* http_client_get_connection(void* arg)
+{
+	return (struct http_connection*)((struct espconn*)arg)->reverse;
+}
+
+static void http_client_update_heap(struct http_request* request)
+{
+	uint32 free_heap = system_get_free_heap_size();
+	if (request->min_free_heap == 0 || free_heap < request->min_free_heap)
+	{
+		request->min_free_heap = free_heap;
+	}
+	METRICS_HEAP();
+}
+
+// Server may silently drop idle keep-alive connection - request sent over it gets no response at all
+static bool http_client_is_dropped(const struct http_request* request)
+{
+	return request->is_connection_reused &&
+			request->parser.state == HTTP_STATE_STATUS_LINE &&
+			request->parser.line_len == 0;
+}
+
+static uint8 http_client_get_result(struct http_request* request)
+{
+	if (request->parser.is_gzip && !inflate_is_complete(&request->inflater))
+	{
+		if (request->is_gzip_requested)
+		{
+			// identity encoding is requested until it succeeds (e.g. history window does not fit into heap)
+			http_stats.is_gzip_disabled = true;
+			return HTTP_RESULT_ERROR_INFLATE;
+		}
+		return HTTP_RESULT_ERROR_RESPONSE;
+	}
+	if (request->parser.state != HTTP_STATE_DONE)
+	{
+		return HTTP_RESULT_ERROR_RESPONSE;
+	}
+	if (!request->parser.is_gzip)
+	{
+		// server is responsive again - next request asks for compressed response once more
+		http_stats.is_gzip_disabled = false;
+	}
+	return HTTP_RESULT_OK;
+}
+
+static void http_client_complete(struct http_request* request, uint8 result)
+{
+	inflate_release(&request->inflater);
+	request->state = HTTP_REQUEST_IDLE;
+	if (result != HTTP_RESULT_OK)
+	{
+		++http_stats.failures;
+	}
+	if (request->on_complete)
+	{
+		request->on_complete(request, result);
+	}
+}
+
+// Connection is closed from its task rather than from espconn callbacks
+static void http_client_close(struct http_connection* connection)
+{
+	if (!connection->is_close_pending)
+	{
+		connection->is_close_pending = true;
+		sched_set_deadline(close_task, HTTP_CLIENT_CLOSE_DELAY);
+	}
+}
+
+// Connection is gone: its request is completed (or queued again to be sent over a new connection
+// if it has been dropped by server) and waiting requests are dispatched
+static void http_client_release(struct http_connection* connection, uint8 result)
+{
+	struct http_request* request = connection->request;
+	connection->request = NULL;
+	connection->state = HTTP_CONNECTION_FREE;
+	connection->is_close_pending = false;
+	if (request && http_client_is_dropped(request))
+	{
+		++http_stats.retries;
+		request->is_retried = true;
+		request->state = HTTP_REQUEST_QUEUED;
+		request->next = http_queue;
+		http_queue = request;
+	}
+	else if (request)
+	{
+		http_client_complete(request, result);
+	}
+	http_client_dispatch();
+}
+
+static void close_task_handler(void* arg)
+{
+	uint8 i;
+	for (i = 0; i < HTTP_CLIENT_MAX_CONNECTIONS; ++i)
+	{
+		struct http_connection* connection = &http_connections[i];
+		if (!connection->is_close_pending)
+		{
+			continue;
+		}
+		connection->is_close_pending = false;
+		connection->state = HTTP_CONNECTION_CLOSING;
+		sint8 result = connection->is_secure ?
+				espconn_secure_disconnect(&connection->conn) :
+				espconn_disconnect(&connection->conn);
+		if (result != ESPCONN_OK)
+		{
+			http_client_release(connection, HTTP_RESULT_ERROR_CONNECTION);
+		}
+	}
+}
+
+// Sends GET request over open connection (TX buffer is a scoped arena allocation)
+static sint8 http_client_send(struct http_connection* connection)
+{
+	struct http_request* request = connection->request;
+	sint8 result;
+	size_t mark = arena_mark();
+	char* tx_buf = (char*)arena_alloc(HTTP_TX_BUFFER_SIZE);
+	// history window is sized to free heap with TLS connection open (allocated once body arrives),
+	// gzip is skipped while not even the smallest window fits
+	uint32 free_heap = system_get_free_heap_size();
+	request->window_bits = inflate_fit_window_bits(free_heap > HTTP_CLIENT_GZIP_HEAP_RESERVE ? free_heap - HTTP_CLIENT_GZIP_HEAP_RESERVE : 0);
+	request->is_gzip_requested = request->is_gzip && !http_stats.is_gzip_disabled && request->window_bits > 0;
+	int tx_len = os_snprintf(tx_buf, HTTP_TX_BUFFER_SIZE, "GET %s HTTP/1.1\r\nHost: %s\r\nAccept: */*\r\n%s%s\r\n",
+			request->path,
+			request->hostname,
+			request->is_gzip_requested ? "Accept-Encoding: gzip\r\n" : "",
+			request->is_keep_alive ? "Connection: keep-alive\r\n" : "");
+	if (tx_len < 0 || tx_len >= HTTP_TX_BUFFER_SIZE)
+	{
+		result = ESPCONN_ARG;
+	}
+	else if (connection->is_secure)
+	{
+		result = espconn_secure_send(&connection->conn, (uint8*)tx_buf, tx_len);
+	}
+	else
+	{
+		result = espconn_send(&connection->conn, (uint8*)tx_buf, tx_len);
+	}
+	if (result == ESPCONN_OK)
+	{
+		METRICS_BEGIN(METRICS_PHASE_FIRST_BYTE);
+	}
+	arena_release(mark);
+	return result;
+}
+
+static void http_client_connect(struct http_connection* connection)
+{
+	sint8 result;
+	connection->state = HTTP_CONNECTION_CONNECTING;
+	connection->tcp.remote_port = connection->is_secure ? 443 : 80;
+	os_memcpy(connection->tcp.remote_ip, &connection->server_ip.addr, 4);
+	espconn_regist_connectcb(&connection->conn, http_client_on_connected);
+	espconn_regist_reconcb(&connection->conn, http_client_on_failed);
+	connection->connect_start_time = system_get_time();
+	METRICS_BEGIN(METRICS_PHASE_CONNECT);
+	if (connection->is_secure)
+	{
+		result = espconn_secure_connect(&connection->conn);
+	}
+	else
+	{
+		result = espconn_connect(&connection->conn);
+	}
+	if (result != ESPCONN_OK)
+	{
+		connection->request->connection_error = result;
+		http_client_release(connection, HTTP_RESULT_ERROR_CONNECTION);
+	}
+}
+
+static void http_client_on_dns_resolved(const char* hostname, ip_addr_t* ip, void* arg)
+{
+	struct http_connection* connection = http_client_get_connection(arg);
+	if (connection->state != HTTP_CONNECTION_RESOLVING)
+	{
+		return;
+	}
+	if (!ip)
+	{
+		http_client_release(connection, HTTP_RESULT_ERROR_DNS);
+		return;
+	}
+	METRICS_END(METRICS_PHASE_DNS);
+	connection->server_ip.addr = ip->addr;
+	dns_cache_store(hostname, ip->addr, DNS_CACHE_TTL, (uint32)(sched_now_ms() / 1000));
+	http_client_connect(connection);
+}
+
+static void http_client_on_connected(void* arg)
+{
+	struct http_connection* connection = http_client_get_connection(arg);
+	struct http_request* request = connection->request;
+	request->handshake_duration = system_get_time() - connection->connect_start_time;
+	METRICS_END(METRICS_PHASE_CONNECT);
+	http_client_update_heap(request);
+	connection->state = HTTP_CONNECTION_OPEN;
+	espconn_regist_disconcb(&connection->conn, http_client_on_closed);
+	espconn_regist_recvcb(&connection->conn, http_client_on_receive);
+	if (http_client_send(connection) != ESPCONN_OK)
+	{
+		http_client_close(connection);
+	}
+}
+
+// Body bytes are passed to request as they arrive (compressed body is inflated on the fly)
+static void http_client_on_body(void* arg, const char* data, size_t len)
+{
+	struct http_request* request = (struct http_request*)arg;
+	if (!request->parser.is_gzip)
+	{
+		request->on_body(request->arg, data, len);
+		return;
+	}
+	// history window is allocated once compressed body starts (after TLS handshake buffers are settled)
+	if (!request->inflater.window && request->inflater.state == INFLATE_STATE_GZIP_HEADER)
+	{
+		inflate_init(&request->inflater, request->window_bits, request->on_body, request->arg);
+		http_client_update_heap(request);
+	}
+	if (request->inflater.state != INFLATE_STATE_ERROR && inflate_feed(&request->inflater, data, len) != INFLATE_OK)
+	{
+		inflate_release(&request->inflater);
+	}
+}
+
+static void http_client_on_receive(void* arg, char* data, unsigned short len)
+{
+	struct http_connection* connection = http_client_get_connection(arg);
+	struct http_request* request = connection->request;
+	if (!request || connection->is_close_pending)
+	{
+		return;
+	}
+	http_client_update_heap(request);
+	METRICS_BYTES(len);
+	METRICS_END(METRICS_PHASE_FIRST_BYTE);
+	METRICS_RESUME(METRICS_PHASE_DOWNLOAD);
+	METRICS_RESUME(METRICS_PHASE_PARSE);
+	http_parser_feed(&request->parser, data, len);
+	METRICS_PAUSE(METRICS_PHASE_PARSE);
+	if (!http_parser_is_complete(&request->parser))
+	{
+		return;
+	}
+	METRICS_END(METRICS_PHASE_DOWNLOAD);
+	// request is completed right away, connection either stays open for the next request or is closed
+	connection->request = NULL;
+	if (!request->is_keep_alive || request->parser.error != HTTP_PARSE_OK || request->parser.is_connection_close)
+	{
+		http_client_close(connection);
+	}
+	http_client_complete(request, http_client_get_result(request));
+	http_client_dispatch();
+}
+
+static void http_client_on_closed(void* arg)
+{
+	struct http_connection* connection = http_client_get_connection(arg);
+	struct http_request* request = connection->request;
+	if (request)
+	{
+		// response without Content-Length and chunked encoding is complete once server closes connection
+		http_parser_finish(&request->parser);
+	}
+	http_client_release(connection, request ? http_client_get_result(request) : HTTP_RESULT_OK);
+}
+
+static void http_client_on_failed(void* arg, sint8 error)
+{
+	struct http_connection* connection = http_client_get_connection(arg);
+	struct http_request* request = connection->request;
+	if (request && !http_client_is_dropped(request))
+	{
+		// cached address might be outdated - next request resolves hostname again
+		request->connection_error = error;
+		dns_cache_invalidate(request->hostname);
+	}
+	http_client_release(connection, HTTP_RESULT_ERROR_CONNECTION);
+}
+
+static void http_client_start(struct http_connection* connection, struct http_request* request)
+{
+	request->state = HTTP_REQUEST_ACTIVE;
+	request->connection_error = ESPCONN_OK;
+	request->min_free_heap = 0;
+	http_parser_init(&request->parser, http_client_on_body, request);
+	os_bzero(&request->inflater, sizeof(struct inflate_stream));
+	http_client_update_heap(request);
+	connection->request = request;
+	++http_stats.requests;
+	if (connection->state == HTTP_CONNECTION_OPEN)
+	{
+		request->is_connection_reused = true;
+		request->handshake_duration = 0;
+		++http_stats.reused;
+		if (http_client_send(connection) != ESPCONN_OK)
+		{
+			// disconnect callback detects dropped connection and queues request again
+			http_client_close(connection);
+		}
+		return;
+	}
+	request->is_connection_reused = false;
+	// connection structures are statically allocated - never taken from heap
+	os_bzero(&connection->conn, sizeof(struct espconn));
+	os_bzero(&connection->tcp, sizeof(esp_tcp));
+	connection->conn.type = ESPCONN_TCP;
+	connection->conn.state = ESPCONN_NONE;
+	connection->conn.proto.tcp = &connection->tcp;
+	connection->conn.reverse = connection;
+	connection->is_secure = request->url_type == HTTP_URL_HTTPS;
+	connection->is_close_pending = false;
+	os_strcpy(connection->hostname, request->hostname);
+	connection->state = HTTP_CONNECTION_RESOLVING;
+	uint8 i;
+	uint8 open_count = 0;
+	for (i = 0; i < HTTP_CLIENT_MAX_CONNECTIONS; ++i)
+	{
+		open_count += http_connections[i].state != HTTP_CONNECTION_FREE;
+	}
+	http_stats.peak_connections = open_count > http_stats.peak_connections ? open_count : http_stats.peak_connections;
+	// cached address is used while it is not expired
+	uint32 cached_addr;
+	if (dns_cache_lookup(connection->hostname, (uint32)(sched_now_ms() / 1000), &cached_addr))
+	{
+		connection->server_ip.addr = cached_addr;
+		http_client_connect(connection);
+		return;
+	}
+	METRICS_BEGIN(METRICS_PHASE_DNS);
+	sint8 result = espconn_gethostbyname(&connection->conn, connection->hostname, &connection->server_ip, http_client_on_dns_resolved);
+	if (result == ESPCONN_OK)
+	{
+		// address is already known by lwIP DNS table - callback is not triggered in this case
+		http_client_on_dns_resolved(connection->hostname, &connection->server_ip, &connection->conn);
+	}
+	else if (result != ESPCONN_INPROGRESS)
+	{
+		http_client_on_dns_resolved(connection->hostname, NULL, &connection->conn);
+	}
+}
+
+// Picks connection for request: idle connection kept alive to the same host, or a free one within limits.
+// If limits are reached, idle connection is closed to make room (request waits until it is closed)
+static struct http_connection* http_client_find_connection(const struct http_request* request)
+{
+	bool is_secure = request->url_type == HTTP_URL_HTTPS;
+	struct http_connection* free_connection = NULL;
+	struct http_connection* idle_connection = NULL;
+	struct http_connection* idle_secure_connection = NULL;
+	uint8 open_count = 0;
+	uint8 secure_count = 0;
+	uint8 i;
+	for (i = 0; i < HTTP_CLIENT_MAX_CONNECTIONS; ++i)
+	{
+		struct http_connection* connection = &http_connections[i];
+		if (connection->state == HTTP_CONNECTION_FREE)
+		{
+			free_connection = free_connection ? free_connection : connection;
+			continue;
+		}
+		++open_count;
+		secure_count += connection->is_secure;
+		if (connection->state != HTTP_CONNECTION_OPEN || connection->request || connection->is_close_pending)
+		{
+			continue;
+		}
+		if (request->is_keep_alive && !request->is_retried && connection->is_secure == is_secure &&
+				os_strcmp(connection->hostname, request->hostname) == 0)
+		{
+			return connection;
+		}
+		idle_connection = connection;
+		idle_secure_connection = connection->is_secure ? connection : idle_secure_connection;
+	}
+	bool is_secure_limit_reached = is_secure && secure_count >= HTTP_CLIENT_MAX_SECURE_CONNECTIONS;
+	if (open_count < http_max_connections && !is_secure_limit_reached)
+	{
+		return free_connection;
+	}
+	if (is_secure_limit_reached && idle_secure_connection)
+	{
+		http_client_close(idle_secure_connection);
+	}
+	else if (!is_secure_limit_reached && idle_connection)
+	{
+		http_client_close(idle_connection);
+	}
+	return NULL;
+}
+
+// Starts waiting requests in submission order while connections are available
+static void http_client_dispatch(void)
+{
+	bool is_started = true;
+	while (is_started)
+	{
+		struct http_request** link;
+		is_started = false;
+		for (link = &http_queue; *link; link = &(*link)->next)
+		{
+			struct http_request* request = *link;
+			struct http_connection* connection = http_client_find_connection(request);
+			if (connection)
+			{
+				// queue is scanned again from its head, as starting request may complete other requests
+				*link = request->next;
+				request->next = NULL;
+				http_client_start(connection, request);
+				is_started = true;
+				break;
+			}
+		}
+	}
+}
+
+// At most 'max_connections' (up to HTTP_CLIENT_MAX_CONNECTIONS) connections are open at a time
+void http_client_init(uint8 max_connections)
+{
+	os_bzero(http_connections, sizeof(http_connections));
+	os_bzero(&http_stats, sizeof(struct http_client_stats));
+	http_queue = NULL;
+	http_max_connections = max_connections < HTTP_CLIENT_MAX_CONNECTIONS ? max_connections : HTTP_CLIENT_MAX_CONNECTIONS;
+	http_max_connections = http_max_connections ? http_max_connections : 1;
+	close_task = sched_add("http_close", close_task_handler, NULL, 0);
+}
+
+void http_request_init(struct http_request* request, http_body_callback on_body, http_request_callback on_complete, void* arg)
+{
+	os_bzero(request, sizeof(struct http_request));
+	request->on_body = on_body;
+	request->on_complete = on_complete;
+	request->arg = arg;
+}
+
+// Queues GET request of 'url' (request which is already submitted or URL which does not fit into request is rejected),
+// completion callback is triggered once response is received or request has failed
+bool http_client_submit(struct http_request* request, const char* url)
+{
+	if (request->state != HTTP_REQUEST_IDLE)
+	{
+		return false;
+	}
+	int url_type = parse_url(url, request->hostname, sizeof(request->hostname), request->path, sizeof(request->path));
+	if (url_type == HTTP_URL_INVALID)
+	{
+		return false;
+	}
+	request->url_type = url_type;
+	request->is_retried = false;
+	request->state = HTTP_REQUEST_QUEUED;
+	request->next = NULL;
+	struct http_request** link = &http_queue;
+	while (*link)
+	{
+		link = &(*link)->next;
+	}
+	*link = request;
+	http_client_dispatch();
+	return true;
+}
+
+const struct http_client_stats* http_client_get_stats(void)
+{
+	return &http_stats;
+}
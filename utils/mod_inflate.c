@@ -0,0 +1,684 @@
+#include "mod_inflate.h"
+
+#include <osapi.h>
+#include <mem.h>
+
+// Streaming gzip (RFC 1952) / deflate (RFC 1951) decoder. Each state consumes a bounded
+// number of bits (at most 24) - when input runs out, already fetched bits stay in bit buffer
+// and the same state is re-entered with the next received segment.
+
+#define INFLATE_GZIP_ID1                        0x1F
+#define INFLATE_GZIP_ID2                        0x8B
+#define INFLATE_GZIP_METHOD_DEFLATE             8
+#define INFLATE_GZIP_HEADER_SIZE                10
+#define INFLATE_GZIP_TRAILER_SIZE               8
+
+#define INFLATE_GZIP_FLAG_HCRC                  0x02
+#define INFLATE_GZIP_FLAG_EXTRA                 0x04
+#define INFLATE_GZIP_FLAG_NAME                  0x08
+#define INFLATE_GZIP_FLAG_COMMENT               0x10
+
+#define INFLATE_BLOCK_STORED                    0
+#define INFLATE_BLOCK_FIXED                     1
+#define INFLATE_BLOCK_DYNAMIC                   2
+
+#define INFLATE_SYMBOL_END_OF_BLOCK             256
+#define INFLATE_DECODE_NEED_INPUT               -1
+#define INFLATE_DECODE_INVALID                  -2
+
+static const uint16 LENGTH_BASE[] =
+{
+		3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+		35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258
+};
+
+static const uint16 LENGTH_EXTRA[] =
+{
+		0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+		3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0
+};
+
+static const uint16 DIST_BASE[] =
+{
+		1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+		257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577
+};
+
+static const uint16 DIST_EXTRA[] =
+{
+		0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+		7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13
+};
+
+// order of code length code lengths in dynamic block header
+static const uint16 CODE_LENGTH_ORDER[] =
+{
+		16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15
+};
+
+// CRC-32 (reflected, polynomial 0xEDB88320) processed by nibbles
+static const uint32 CRC32_NIBBLE_TABLE[] =
+{
+		0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC, 0x76DC4190, 0x6B6B51F4, 0x4DB26158, 0x5005713C,
+		0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C, 0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C
+};
+
+static uint32 inflate_crc32(uint32 crc, const uint8* data, size_t len)
+{
+	size_t i;
+	for (i = 0; i < len; ++i)
+	{
+		crc ^= data[i];
+		crc = (crc >> 4) ^ CRC32_NIBBLE_TABLE[crc & 0x0F];
+		crc = (crc >> 4) ^ CRC32_NIBBLE_TABLE[crc & 0x0F];
+	}
+	return crc;
+}
+
+static void inflate_fail(struct inflate_stream* stream, sint8 error)
+{
+	stream->error = error;
+	stream->state = INFLATE_STATE_ERROR;
+}
+
+// Fetches input bytes until bit buffer holds at least 'count' (up to 24) bits
+static bool inflate_need_bits(struct inflate_stream* stream, uint8 count)
+{
+	while (stream->bit_count < count)
+	{
+		if (stream->input == stream->input_end)
+		{
+			return false;
+		}
+		stream->bit_buffer |= (uint32)(*stream->input++) << stream->bit_count;
+		stream->bit_count += 8;
+	}
+	return true;
+}
+
+static uint32 inflate_take_bits(struct inflate_stream* stream, uint8 count)
+{
+	uint32 result = stream->bit_buffer & ((1UL << count) - 1);
+	stream->bit_buffer >>= count;
+	stream->bit_count -= count;
+	return result;
+}
+
+static void inflate_align_to_byte(struct inflate_stream* stream)
+{
+	inflate_take_bits(stream, stream->bit_count & 7);
+}
+
+// Passes not yet flushed window bytes to output callback
+static void inflate_flush(struct inflate_stream* stream)
+{
+	if (stream->window_pos > stream->flushed_pos)
+	{
+		size_t len = stream->window_pos - stream->flushed_pos;
+		const uint8* data = stream->window + stream->flushed_pos;
+		stream->crc = inflate_crc32(stream->crc, data, len);
+		if (stream->on_output)
+		{
+			stream->on_output(stream->arg, (const char*)data, len);
+		}
+		stream->flushed_pos = stream->window_pos;
+	}
+}
+
+static void inflate_put(struct inflate_stream* stream, uint8 value)
+{
+	stream->window[stream->window_pos] = value;
+	++stream->total_out;
+	if ((uint32)stream->window_pos + 1 == (1UL << stream->window_bits))
+	{
+		stream->window_pos = stream->window_pos + 1;
+		inflate_flush(stream);
+		stream->window_pos = 0;
+		stream->flushed_pos = 0;
+	}
+	else
+	{
+		++stream->window_pos;
+	}
+}
+
+// Builds canonical Huffman decoding table, returns number of missing codes (negative if over-subscribed)
+static int inflate_build(uint16* counts, uint16* symbols, const uint8* lengths, uint16 n)
+{
+	uint16 offsets[INFLATE_MAX_CODE_BITS + 1];
+	uint16 symbol;
+	uint16 len;
+	int left = 1;
+	os_bzero(counts, sizeof(uint16) * (INFLATE_MAX_CODE_BITS + 1));
+	for (symbol = 0; symbol < n; ++symbol)
+	{
+		++counts[lengths[symbol]];
+	}
+	if (counts[0] == n)
+	{
+		return 0;
+	}
+	for (len = 1; len <= INFLATE_MAX_CODE_BITS; ++len)
+	{
+		left <<= 1;
+		left -= counts[len];
+		if (left < 0)
+		{
+			return left;
+		}
+	}
+	offsets[1] = 0;
+	for (len = 1; len < INFLATE_MAX_CODE_BITS; ++len)
+	{
+		offsets[len + 1] = offsets[len] + counts[len];
+	}
+	for (symbol = 0; symbol < n; ++symbol)
+	{
+		if (lengths[symbol])
+		{
+			symbols[offsets[lengths[symbol]]++] = symbol;
+		}
+	}
+	return left;
+}
+
+// Decodes one symbol - bits are consumed only once the whole code is available
+static int inflate_decode(struct inflate_stream* stream, const uint16* counts, const uint16* symbols)
+{
+	int code = 0;
+	int first = 0;
+	int index = 0;
+	uint8 len;
+	for (len = 1; len <= INFLATE_MAX_CODE_BITS; ++len)
+	{
+		if (!inflate_need_bits(stream, len))
+		{
+			return INFLATE_DECODE_NEED_INPUT;
+		}
+		code |= (stream->bit_buffer >> (len - 1)) & 1;
+		int count = counts[len];
+		if (code - count < first)
+		{
+			inflate_take_bits(stream, len);
+			return symbols[index + (code - first)];
+		}
+		index += count;
+		first += count;
+		first <<= 1;
+		code <<= 1;
+	}
+	return INFLATE_DECODE_INVALID;
+}
+
+static void inflate_build_fixed(struct inflate_stream* stream)
+{
+	uint16 symbol;
+	for (symbol = 0; symbol < INFLATE_MAX_LITLEN_CODES; ++symbol)
+	{
+		stream->lengths[symbol] = symbol < 144 ? 8 : (symbol < 256 ? 9 : (symbol < 280 ? 7 : 8));
+	}
+	inflate_build(stream->litlen_counts, stream->litlen_symbols, stream->lengths, INFLATE_MAX_LITLEN_CODES);
+	for (symbol = 0; symbol < INFLATE_MAX_DIST_CODES; ++symbol)
+	{
+		stream->lengths[symbol] = 5;
+	}
+	inflate_build(stream->dist_counts, stream->dist_symbols, stream->lengths, INFLATE_MAX_DIST_CODES);
+}
+
+// Selects next optional gzip header field (or first deflate block)
+static void inflate_next_header_field(struct inflate_stream* stream)
+{
+	stream->count = 0;
+	if (stream->gzip_flags & INFLATE_GZIP_FLAG_EXTRA)
+	{
+		stream->gzip_flags &= ~INFLATE_GZIP_FLAG_EXTRA;
+		stream->state = INFLATE_STATE_GZIP_EXTRA_LEN;
+	}
+	else if (stream->gzip_flags & INFLATE_GZIP_FLAG_NAME)
+	{
+		stream->gzip_flags &= ~INFLATE_GZIP_FLAG_NAME;
+		stream->state = INFLATE_STATE_GZIP_NAME;
+	}
+	else if (stream->gzip_flags & INFLATE_GZIP_FLAG_COMMENT)
+	{
+		stream->gzip_flags &= ~INFLATE_GZIP_FLAG_COMMENT;
+		stream->state = INFLATE_STATE_GZIP_COMMENT;
+	}
+	else if (stream->gzip_flags & INFLATE_GZIP_FLAG_HCRC)
+	{
+		stream->gzip_flags &= ~INFLATE_GZIP_FLAG_HCRC;
+		stream->state = INFLATE_STATE_GZIP_HEADER_CRC;
+	}
+	else
+	{
+		stream->state = INFLATE_STATE_BLOCK_HEADER;
+	}
+}
+
+static void inflate_end_of_block(struct inflate_stream* stream)
+{
+	if (stream->is_last_block)
+	{
+		inflate_flush(stream);
+		inflate_align_to_byte(stream);
+		stream->count = 0;
+		stream->trailer = 0;
+		stream->state = INFLATE_STATE_TRAILER;
+	}
+	else
+	{
+		stream->state = INFLATE_STATE_BLOCK_HEADER;
+	}
+}
+
+// Copies back reference from history window
+static void inflate_copy(struct inflate_stream* stream, uint16 distance)
+{
+	uint32 window_mask = (1UL << stream->window_bits) - 1;
+	if (distance > stream->total_out || distance > window_mask + 1)
+	{
+		inflate_fail(stream, INFLATE_ERROR_DISTANCE);
+		return;
+	}
+	if (distance > stream->max_distance)
+	{
+		stream->max_distance = distance;
+	}
+	uint32 from = ((uint32)stream->window_pos - distance) & window_mask;
+	uint16 i;
+	for (i = 0; i < stream->length; ++i)
+	{
+		inflate_put(stream, stream->window[from]);
+		from = (from + 1) & window_mask;
+	}
+}
+
+// Reads dynamic block code lengths, returns false if more input is needed
+static bool inflate_read_lengths(struct inflate_stream* stream)
+{
+	uint16 total = stream->nlen + stream->ndist;
+	while (stream->count < total)
+	{
+		if (stream->state == INFLATE_STATE_LENS)
+		{
+			int symbol = inflate_decode(stream, stream->dist_counts, stream->dist_symbols);
+			if (symbol == INFLATE_DECODE_NEED_INPUT)
+			{
+				return false;
+			}
+			if (symbol < 0)
+			{
+				inflate_fail(stream, INFLATE_ERROR_CODES);
+				return true;
+			}
+			if (symbol < 16)
+			{
+				stream->lengths[stream->count++] = symbol;
+				continue;
+			}
+			stream->symbol = symbol;
+			stream->state = INFLATE_STATE_LENS_REPEAT;
+		}
+		// repeat previous length (16), or zero length (17, 18)
+		uint8 extra_bits = stream->symbol == 16 ? 2 : (stream->symbol == 17 ? 3 : 7);
+		if (!inflate_need_bits(stream, extra_bits))
+		{
+			return false;
+		}
+		uint16 repeat = inflate_take_bits(stream, extra_bits) + (stream->symbol == 18 ? 11 : 3);
+		uint8 value = 0;
+		if (stream->symbol == 16)
+		{
+			if (stream->count == 0)
+			{
+				inflate_fail(stream, INFLATE_ERROR_CODES);
+				return true;
+			}
+			value = stream->lengths[stream->count - 1];
+		}
+		if (stream->count + repeat > total)
+		{
+			inflate_fail(stream, INFLATE_ERROR_CODES);
+			return true;
+		}
+		while (repeat--)
+		{
+			stream->lengths[stream->count++] = value;
+		}
+		stream->state = INFLATE_STATE_LENS;
+	}
+
+	// end of block code is mandatory, incomplete literal/length code is only allowed for a single code
+	int left = inflate_build(stream->litlen_counts, stream->litlen_symbols, stream->lengths, stream->nlen);
+	if (stream->lengths[INFLATE_SYMBOL_END_OF_BLOCK] == 0 ||
+		left < 0 ||
+		(left > 0 && stream->nlen - stream->litlen_counts[0] != 1))
+	{
+		inflate_fail(stream, INFLATE_ERROR_CODES);
+		return true;
+	}
+	left = inflate_build(stream->dist_counts, stream->dist_symbols, stream->lengths + stream->nlen, stream->ndist);
+	if (left < 0 || (left > 0 && stream->ndist - stream->dist_counts[0] != 1))
+	{
+		inflate_fail(stream, INFLATE_ERROR_CODES);
+		return true;
+	}
+	stream->state = INFLATE_STATE_LITLEN;
+	return true;
+}
+
+// The largest history window (bits) fitting into 'available' bytes, 0 if even INFLATE_WINDOW_BITS window does not fit
+uint8 inflate_fit_window_bits(uint32 available)
+{
+	uint8 window_bits;
+	for (window_bits = INFLATE_WINDOW_BITS_MAX; window_bits >= INFLATE_WINDOW_BITS; --window_bits)
+	{
+		if ((1UL << window_bits) <= available)
+		{
+			return window_bits;
+		}
+	}
+	return 0;
+}
+
+bool inflate_init(struct inflate_stream* stream, uint8 window_bits, inflate_output_callback on_output, void* arg)
+{
+	os_bzero(stream, sizeof(struct inflate_stream));
+	stream->state = INFLATE_STATE_GZIP_HEADER;
+	stream->error = INFLATE_OK;
+	stream->window_bits = window_bits;
+	stream->crc = 0xFFFFFFFF;
+	stream->on_output = on_output;
+	stream->arg = arg;
+	if (window_bits < INFLATE_WINDOW_BITS_MIN || window_bits > INFLATE_WINDOW_BITS_MAX)
+	{
+		inflate_fail(stream, INFLATE_ERROR_MEMORY);
+		return false;
+	}
+	stream->window = (uint8*)os_malloc(1UL << window_bits);
+	if (!stream->window)
+	{
+		inflate_fail(stream, INFLATE_ERROR_MEMORY);
+		return false;
+	}
+	return true;
+}
+
+int inflate_feed(struct inflate_stream* stream, const char* data, size_t len)
+{
+	stream->input = (const uint8*)data;
+	stream->input_end = stream->input + len;
+	bool is_suspended = false;
+	while (!is_suspended && stream->state < INFLATE_STATE_DONE)
+	{
+		switch (stream->state)
+		{
+			case INFLATE_STATE_GZIP_HEADER:
+				while (stream->count < INFLATE_GZIP_HEADER_SIZE && inflate_need_bits(stream, 8))
+				{
+					uint8 value = inflate_take_bits(stream, 8);
+					if ((stream->count == 0 && value != INFLATE_GZIP_ID1) ||
+						(stream->count == 1 && value != INFLATE_GZIP_ID2) ||
+						(stream->count == 2 && value != INFLATE_GZIP_METHOD_DEFLATE))
+					{
+						inflate_fail(stream, INFLATE_ERROR_HEADER);
+						break;
+					}
+					if (stream->count == 3)
+					{
+						stream->gzip_flags = value;
+					}
+					++stream->count;
+				}
+				if (stream->state == INFLATE_STATE_GZIP_HEADER)
+				{
+					is_suspended = (stream->count < INFLATE_GZIP_HEADER_SIZE);
+					if (!is_suspended)
+					{
+						inflate_next_header_field(stream);
+					}
+				}
+				break;
+			case INFLATE_STATE_GZIP_EXTRA_LEN:
+				if (!(is_suspended = !inflate_need_bits(stream, 16)))
+				{
+					stream->length = inflate_take_bits(stream, 16);
+					stream->state = INFLATE_STATE_GZIP_EXTRA;
+				}
+				break;
+			case INFLATE_STATE_GZIP_EXTRA:
+				while (stream->count < stream->length && inflate_need_bits(stream, 8))
+				{
+					inflate_take_bits(stream, 8);
+					++stream->count;
+				}
+				is_suspended = (stream->count < stream->length);
+				if (!is_suspended)
+				{
+					inflate_next_header_field(stream);
+				}
+				break;
+			case INFLATE_STATE_GZIP_NAME:
+			case INFLATE_STATE_GZIP_COMMENT:
+				// zero-terminated string
+				while (!(is_suspended = !inflate_need_bits(stream, 8)))
+				{
+					if (inflate_take_bits(stream, 8) == 0)
+					{
+						inflate_next_header_field(stream);
+						break;
+					}
+				}
+				break;
+			case INFLATE_STATE_GZIP_HEADER_CRC:
+				if (!(is_suspended = !inflate_need_bits(stream, 16)))
+				{
+					inflate_take_bits(stream, 16);
+					inflate_next_header_field(stream);
+				}
+				break;
+			case INFLATE_STATE_BLOCK_HEADER:
+				if (!(is_suspended = !inflate_need_bits(stream, 3)))
+				{
+					stream->is_last_block = inflate_take_bits(stream, 1);
+					uint8 block_type = inflate_take_bits(stream, 2);
+					stream->count = 0;
+					if (block_type == INFLATE_BLOCK_STORED)
+					{
+						inflate_align_to_byte(stream);
+						stream->state = INFLATE_STATE_STORED_LEN;
+					}
+					else if (block_type == INFLATE_BLOCK_FIXED)
+					{
+						inflate_build_fixed(stream);
+						stream->state = INFLATE_STATE_LITLEN;
+					}
+					else if (block_type == INFLATE_BLOCK_DYNAMIC)
+					{
+						stream->state = INFLATE_STATE_TABLE_SIZES;
+					}
+					else
+					{
+						inflate_fail(stream, INFLATE_ERROR_BLOCK);
+					}
+				}
+				break;
+			case INFLATE_STATE_STORED_LEN:
+				// LEN followed by its one's complement NLEN
+				if (!(is_suspended = !inflate_need_bits(stream, 16)))
+				{
+					uint16 value = inflate_take_bits(stream, 16);
+					if (stream->count == 0)
+					{
+						stream->length = value;
+						stream->count = 1;
+					}
+					else if ((uint16)(value + stream->length) != 0xFFFF)
+					{
+						inflate_fail(stream, INFLATE_ERROR_BLOCK);
+					}
+					else
+					{
+						stream->state = INFLATE_STATE_STORED_DATA;
+					}
+				}
+				break;
+			case INFLATE_STATE_STORED_DATA:
+				while (stream->length > 0 && inflate_need_bits(stream, 8))
+				{
+					inflate_put(stream, inflate_take_bits(stream, 8));
+					--stream->length;
+				}
+				is_suspended = (stream->length > 0);
+				if (!is_suspended)
+				{
+					inflate_end_of_block(stream);
+				}
+				break;
+			case INFLATE_STATE_TABLE_SIZES:
+				if (!(is_suspended = !inflate_need_bits(stream, 14)))
+				{
+					stream->nlen = inflate_take_bits(stream, 5) + 257;
+					stream->ndist = inflate_take_bits(stream, 5) + 1;
+					stream->ncode = inflate_take_bits(stream, 4) + 4;
+					if (stream->nlen > 286 || stream->ndist > INFLATE_MAX_DIST_CODES)
+					{
+						inflate_fail(stream, INFLATE_ERROR_CODES);
+						break;
+					}
+					os_bzero(stream->lengths, sizeof(CODE_LENGTH_ORDER) / sizeof(uint16));
+					stream->count = 0;
+					stream->state = INFLATE_STATE_CODE_LENS;
+				}
+				break;
+			case INFLATE_STATE_CODE_LENS:
+				while (stream->count < stream->ncode && inflate_need_bits(stream, 3))
+				{
+					stream->lengths[CODE_LENGTH_ORDER[stream->count++]] = inflate_take_bits(stream, 3);
+				}
+				is_suspended = (stream->count < stream->ncode);
+				if (!is_suspended)
+				{
+					// code length code is kept in distance table until literal/length and distance codes are read
+					uint16 code_count = sizeof(CODE_LENGTH_ORDER) / sizeof(uint16);
+					if (inflate_build(stream->dist_counts, stream->dist_symbols, stream->lengths, code_count) != 0)
+					{
+						inflate_fail(stream, INFLATE_ERROR_CODES);
+						break;
+					}
+					stream->count = 0;
+					stream->state = INFLATE_STATE_LENS;
+				}
+				break;
+			case INFLATE_STATE_LENS:
+			case INFLATE_STATE_LENS_REPEAT:
+				is_suspended = !inflate_read_lengths(stream);
+				break;
+			case INFLATE_STATE_LITLEN:
+			{
+				int symbol = inflate_decode(stream, stream->litlen_counts, stream->litlen_symbols);
+				if (symbol == INFLATE_DECODE_NEED_INPUT)
+				{
+					is_suspended = true;
+				}
+				else if (symbol < 0 || symbol > INFLATE_SYMBOL_END_OF_BLOCK + 29)
+				{
+					inflate_fail(stream, INFLATE_ERROR_CODES);
+				}
+				else if (symbol < INFLATE_SYMBOL_END_OF_BLOCK)
+				{
+					inflate_put(stream, symbol);
+				}
+				else if (symbol == INFLATE_SYMBOL_END_OF_BLOCK)
+				{
+					inflate_end_of_block(stream);
+				}
+				else
+				{
+					stream->symbol = symbol - INFLATE_SYMBOL_END_OF_BLOCK - 1;
+					stream->state = INFLATE_STATE_LENGTH_EXTRA;
+				}
+				break;
+			}
+			case INFLATE_STATE_LENGTH_EXTRA:
+				if (!(is_suspended = !inflate_need_bits(stream, LENGTH_EXTRA[stream->symbol])))
+				{
+					stream->length = LENGTH_BASE[stream->symbol] + inflate_take_bits(stream, LENGTH_EXTRA[stream->symbol]);
+					stream->state = INFLATE_STATE_DIST;
+				}
+				break;
+			case INFLATE_STATE_DIST:
+			{
+				int symbol = inflate_decode(stream, stream->dist_counts, stream->dist_symbols);
+				if (symbol == INFLATE_DECODE_NEED_INPUT)
+				{
+					is_suspended = true;
+				}
+				else if (symbol < 0 || symbol >= INFLATE_MAX_DIST_CODES)
+				{
+					inflate_fail(stream, INFLATE_ERROR_CODES);
+				}
+				else
+				{
+					stream->symbol = symbol;
+					stream->state = INFLATE_STATE_DIST_EXTRA;
+				}
+				break;
+			}
+			case INFLATE_STATE_DIST_EXTRA:
+				if (!(is_suspended = !inflate_need_bits(stream, DIST_EXTRA[stream->symbol])))
+				{
+					uint16 distance = DIST_BASE[stream->symbol] + inflate_take_bits(stream, DIST_EXTRA[stream->symbol]);
+					stream->state = INFLATE_STATE_LITLEN;
+					inflate_copy(stream, distance);
+				}
+				break;
+			case INFLATE_STATE_TRAILER:
+				// CRC-32 and size (modulo 2^32) of uncompressed data, both little-endian
+				while (stream->count < INFLATE_GZIP_TRAILER_SIZE && inflate_need_bits(stream, 8))
+				{
+					stream->trailer |= inflate_take_bits(stream, 8) << ((stream->count % 4) * 8);
+					if (++stream->count % 4 == 0)
+					{
+						uint32 expected = (stream->count == 4) ? ~stream->crc : stream->total_out;
+						if (stream->trailer != expected)
+						{
+							inflate_fail(stream, INFLATE_ERROR_CHECKSUM);
+							break;
+						}
+						stream->trailer = 0;
+					}
+				}
+				if (stream->state == INFLATE_STATE_TRAILER)
+				{
+					is_suspended = (stream->count < INFLATE_GZIP_TRAILER_SIZE);
+					if (!is_suspended)
+					{
+						stream->state = INFLATE_STATE_DONE;
+					}
+				}
+				break;
+		}
+	}
+	if (stream->state != INFLATE_STATE_ERROR)
+	{
+		inflate_flush(stream);
+	}
+	stream->input = NULL;
+	stream->input_end = NULL;
+	return stream->error;
+}
+
+bool inflate_is_complete(const struct inflate_stream* stream)
+{
+	return stream->state == INFLATE_STATE_DONE;
+}
+
+void inflate_release(struct inflate_stream* stream)
+{
+	if (stream->window)
+	{
+		os_free(stream->window);
+		stream->window = NULL;
+	}
+}
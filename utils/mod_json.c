@@ -0,0 +1,421 @@
+#include "mod_json.h"
+
+#include <osapi.h>
+
+#define JSON_STATE_VALUE                        0
+#define JSON_STATE_VALUE_OR_END                 1
+#define JSON_STATE_KEY                          2
+#define JSON_STATE_KEY_OR_END                   3
+#define JSON_STATE_COLON                        4
+#define JSON_STATE_AFTER_VALUE                  5
+#define JSON_STATE_STRING                       6
+#define JSON_STATE_STRING_ESCAPE                7
+#define JSON_STATE_NUMBER                       8
+#define JSON_STATE_LITERAL                      9
+#define JSON_STATE_ERROR                        10
+
+static bool is_json_whitespace(char ch)
+{
+	return ch == ' ' || ch == '\t' || ch == '\r' || ch == '\n';
+}
+
+static bool is_array_level(const struct json_stream* stream, uint8 depth)
+{
+	return (stream->array_bits >> depth) & 1;
+}
+
+static void json_stream_append(struct json_stream* stream, char ch)
+{
+	// long values are truncated, only the leading part is reported
+	if (stream->token_len < sizeof(stream->token) - 1)
+	{
+		stream->token[stream->token_len++] = ch;
+	}
+}
+
+// Recomputes fields matching current path up to level 'level_idx' (inclusive) after its key or index has changed
+static void json_stream_update_fields(struct json_stream* stream, uint8 level_idx)
+{
+	if (!stream->fields || level_idx >= JSON_STREAM_MAX_DEPTH)
+	{
+		return;
+	}
+	const struct json_stream_level* level = &stream->levels[level_idx];
+	bool is_array = is_array_level(stream, level_idx);
+	uint32 bits = stream->field_bits[level_idx];
+	uint32 matched = 0;
+	uint8 i;
+	for (i = 0; bits; ++i, bits >>= 1)
+	{
+		const struct json_field* field = &stream->fields[i];
+		if (!(bits & 1) || field->depth <= level_idx)
+		{
+			continue;
+		}
+		const struct json_segment* segment = &field->path[level_idx];
+		bool is_match = is_array ?
+				(!segment->key && (segment->index == JSON_INDEX_ANY || segment->index == level->index)) :
+				(segment->key && segment->key_len == level->key_len && os_memcmp(segment->key, level->key, level->key_len) == 0);
+		if (is_match)
+		{
+			matched |= (1UL << i);
+		}
+	}
+	stream->field_bits[level_idx + 1] = matched;
+}
+
+// Stores value of the first field whose whole path matches current position
+static void json_stream_store_field(struct json_stream* stream, uint8 type)
+{
+	stream->field_idx = JSON_FIELD_NONE;
+	if (!stream->fields || stream->depth > JSON_STREAM_MAX_DEPTH)
+	{
+		return;
+	}
+	uint32 bits = stream->field_bits[stream->depth];
+	uint8 i;
+	for (i = 0; bits; ++i, bits >>= 1)
+	{
+		const struct json_field* field = &stream->fields[i];
+		if (!(bits & 1) || field->depth != stream->depth)
+		{
+			continue;
+		}
+		uint8* target = (uint8*)stream->result + field->offset;
+		if (field->kind == JSON_FIELD_STRING && type == JSON_VALUE_STRING)
+		{
+			uint16 len = stream->token_len < field->size ? stream->token_len : field->size - 1;
+			os_memcpy(target, stream->token, len);
+			target[len] = 0;
+		}
+		else if (field->kind == JSON_FIELD_NUMBER && type == JSON_VALUE_NUMBER)
+		{
+			*(sint32*)target = strtol(stream->token, NULL, 10);
+		}
+		else if (field->kind == JSON_FIELD_NUMBER_SUM && type == JSON_VALUE_NUMBER)
+		{
+			*(sint32*)target += strtol(stream->token, NULL, 10);
+		}
+		else if (field->kind != JSON_FIELD_NOTIFY)
+		{
+			continue;
+		}
+		stream->fields_found |= (1UL << i);
+		stream->field_idx = i;
+		return;
+	}
+}
+
+static void json_stream_emit(struct json_stream* stream, uint8 type)
+{
+	stream->token[stream->token_len] = 0;
+	json_stream_store_field(stream, type);
+	if (stream->on_value)
+	{
+		stream->on_value(stream->arg, stream, type, stream->token, stream->token_len);
+	}
+	stream->token_len = 0;
+	stream->state = JSON_STATE_AFTER_VALUE;
+}
+
+static void json_stream_push(struct json_stream* stream, bool is_array)
+{
+	if (stream->depth >= JSON_STREAM_MAX_NESTING)
+	{
+		stream->state = JSON_STATE_ERROR;
+		return;
+	}
+	if (is_array)
+	{
+		stream->array_bits |= (1UL << stream->depth);
+	}
+	else
+	{
+		stream->array_bits &= ~(1UL << stream->depth);
+	}
+	if (stream->depth < JSON_STREAM_MAX_DEPTH)
+	{
+		stream->levels[stream->depth].index = 0;
+		stream->levels[stream->depth].key_len = 0;
+		json_stream_update_fields(stream, stream->depth);
+	}
+	++stream->depth;
+	stream->state = is_array ? JSON_STATE_VALUE_OR_END : JSON_STATE_KEY_OR_END;
+}
+
+static void json_stream_pop(struct json_stream* stream, bool is_array)
+{
+	if (stream->depth == 0 || is_array_level(stream, stream->depth - 1) != is_array)
+	{
+		stream->state = JSON_STATE_ERROR;
+		return;
+	}
+	--stream->depth;
+	stream->state = JSON_STATE_AFTER_VALUE;
+}
+
+static void json_stream_on_key(struct json_stream* stream)
+{
+	if (stream->depth > 0 && stream->depth <= JSON_STREAM_MAX_DEPTH)
+	{
+		struct json_stream_level* level = &stream->levels[stream->depth - 1];
+		if (stream->token_len < sizeof(level->key))
+		{
+			os_memcpy(level->key, stream->token, stream->token_len);
+			level->key_len = stream->token_len;
+		}
+		else
+		{
+			level->key_len = JSON_STREAM_KEY_OVERFLOW;
+		}
+		json_stream_update_fields(stream, stream->depth - 1);
+	}
+	stream->token_len = 0;
+	stream->state = JSON_STATE_COLON;
+}
+
+// Handles single character, returns false in case character needs to be processed again in a new state
+static bool json_stream_step(struct json_stream* stream, char ch)
+{
+	switch (stream->state)
+	{
+		case JSON_STATE_VALUE:
+		case JSON_STATE_VALUE_OR_END:
+			if (ch == '{' || ch == '[')
+			{
+				json_stream_push(stream, ch == '[');
+			}
+			else if (ch == '"')
+			{
+				stream->is_key = false;
+				stream->state = JSON_STATE_STRING;
+			}
+			else if (ch == '-' || (ch >= '0' && ch <= '9'))
+			{
+				json_stream_append(stream, ch);
+				stream->state = JSON_STATE_NUMBER;
+			}
+			else if (ch >= 'a' && ch <= 'z')
+			{
+				json_stream_append(stream, ch);
+				stream->state = JSON_STATE_LITERAL;
+			}
+			else if (ch == ']' && stream->state == JSON_STATE_VALUE_OR_END)
+			{
+				json_stream_pop(stream, true);
+			}
+			else if (!is_json_whitespace(ch))
+			{
+				stream->state = JSON_STATE_ERROR;
+			}
+			break;
+		case JSON_STATE_KEY:
+		case JSON_STATE_KEY_OR_END:
+			if (ch == '"')
+			{
+				stream->is_key = true;
+				stream->state = JSON_STATE_STRING;
+			}
+			else if (ch == '}' && stream->state == JSON_STATE_KEY_OR_END)
+			{
+				json_stream_pop(stream, false);
+			}
+			else if (!is_json_whitespace(ch))
+			{
+				stream->state = JSON_STATE_ERROR;
+			}
+			break;
+		case JSON_STATE_COLON:
+			if (ch == ':')
+			{
+				stream->state = JSON_STATE_VALUE;
+			}
+			else if (!is_json_whitespace(ch))
+			{
+				stream->state = JSON_STATE_ERROR;
+			}
+			break;
+		case JSON_STATE_AFTER_VALUE:
+			if (ch == ',' && stream->depth > 0)
+			{
+				if (is_array_level(stream, stream->depth - 1))
+				{
+					if (stream->depth <= JSON_STREAM_MAX_DEPTH)
+					{
+						++stream->levels[stream->depth - 1].index;
+						json_stream_update_fields(stream, stream->depth - 1);
+					}
+					stream->state = JSON_STATE_VALUE;
+				}
+				else
+				{
+					stream->state = JSON_STATE_KEY;
+				}
+			}
+			else if (ch == '}' || ch == ']')
+			{
+				json_stream_pop(stream, ch == ']');
+			}
+			else if (!is_json_whitespace(ch))
+			{
+				stream->state = JSON_STATE_ERROR;
+			}
+			break;
+		case JSON_STATE_STRING:
+			if (ch == '"')
+			{
+				if (stream->is_key)
+				{
+					json_stream_on_key(stream);
+				}
+				else
+				{
+					json_stream_emit(stream, JSON_VALUE_STRING);
+				}
+			}
+			else if (ch == '\\')
+			{
+				stream->state = JSON_STATE_STRING_ESCAPE;
+			}
+			else
+			{
+				json_stream_append(stream, ch);
+			}
+			break;
+		case JSON_STATE_STRING_ESCAPE:
+			// escape sequences are kept as escaped character (\uXXXX stays as 'uXXXX')
+			json_stream_append(stream, ch);
+			stream->state = JSON_STATE_STRING;
+			break;
+		case JSON_STATE_NUMBER:
+		case JSON_STATE_LITERAL:
+			if ((ch >= '0' && ch <= '9') || (ch >= 'a' && ch <= 'z') || ch == '.' || ch == '-' || ch == '+' || ch == 'E')
+			{
+				json_stream_append(stream, ch);
+			}
+			else
+			{
+				json_stream_emit(stream, stream->state == JSON_STATE_NUMBER ? JSON_VALUE_NUMBER : JSON_VALUE_LITERAL);
+				return false;
+			}
+			break;
+	}
+	return true;
+}
+
+void json_stream_init(struct json_stream* stream, json_value_callback on_value, void* arg)
+{
+	os_bzero(stream, sizeof(struct json_stream));
+	stream->state = JSON_STATE_VALUE;
+	stream->on_value = on_value;
+	stream->arg = arg;
+	stream->field_idx = JSON_FIELD_NONE;
+}
+
+bool json_stream_feed(struct json_stream* stream, const char* data, size_t len)
+{
+	size_t idx = 0;
+	while (idx < len && stream->state != JSON_STATE_ERROR)
+	{
+		if (json_stream_step(stream, data[idx]))
+		{
+			++idx;
+		}
+	}
+	return stream->state != JSON_STATE_ERROR;
+}
+
+// Checks whether current value position matches a path like "routes[0].legs[*].duration.value".
+// Array indices matched by '*' are stored into 'indices' (if provided)
+bool json_stream_match(const struct json_stream* stream, const char* path, uint16* indices)
+{
+	const char* p = path;
+	uint8 i;
+	if (stream->depth > JSON_STREAM_MAX_DEPTH)
+	{
+		return false;
+	}
+	for (i = 0; i < stream->depth; ++i)
+	{
+		const struct json_stream_level* level = &stream->levels[i];
+		if (is_array_level(stream, i))
+		{
+			if (*p++ != '[')
+			{
+				return false;
+			}
+			if (*p == '*')
+			{
+				if (indices)
+				{
+					*indices++ = level->index;
+				}
+				++p;
+			}
+			else
+			{
+				char* index_end;
+				long int index = strtol(p, &index_end, 10);
+				if (index_end == p || index != level->index)
+				{
+					return false;
+				}
+				p = index_end;
+			}
+			if (*p++ != ']')
+			{
+				return false;
+			}
+		}
+		else
+		{
+			size_t name_len = 0;
+			if (*p == '.')
+			{
+				++p;
+			}
+			while (p[name_len] && p[name_len] != '.' && p[name_len] != '[')
+			{
+				++name_len;
+			}
+			if (name_len != level->key_len || os_strncmp(p, level->key, name_len) != 0)
+			{
+				return false;
+			}
+			p += name_len;
+		}
+	}
+	return *p == 0;
+}
+
+// Sets field table matched while document is fed: values found are stored into 'result' structure,
+// which is not cleared (fields_found tells which fields have been set)
+void json_stream_set_fields(struct json_stream* stream, const struct json_field* fields, uint8 fields_count, void* result)
+{
+	stream->fields = fields;
+	stream->fields_count = fields_count < JSON_FIELDS_MAX ? fields_count : JSON_FIELDS_MAX;
+	stream->field_idx = JSON_FIELD_NONE;
+	stream->result = result;
+	stream->fields_found = 0;
+	stream->field_bits[0] = stream->fields_count < JSON_FIELDS_MAX ? (1UL << stream->fields_count) - 1 : 0xFFFFFFFF;
+}
+
+// Array indices matched by JSON_INDEX_ANY segments of field matched by reported value, returns their count
+uint8 json_stream_field_indices(const struct json_stream* stream, uint16* indices)
+{
+	uint8 count = 0;
+	uint8 i;
+	if (stream->field_idx == JSON_FIELD_NONE)
+	{
+		return 0;
+	}
+	const struct json_field* field = &stream->fields[stream->field_idx];
+	for (i = 0; i < field->depth; ++i)
+	{
+		if (!field->path[i].key && field->path[i].index == JSON_INDEX_ANY)
+		{
+			indices[count++] = stream->levels[i].index;
+		}
+	}
+	return count;
+}
@@ -0,0 +1,165 @@
+#include "mod_metrics.h"
+#include "mod_enums.h"
+
+#ifdef QUERY_METRICS
+
+#include <osapi.h>
+#include <user_interface.h>
+
+// Per-phase timing: phase is begun and ended (or failed) by query callbacks, phases measuring
+// CPU time (parsing) are paused / resumed around each processed TCP segment
+
+struct metrics_timer
+{
+	uint32 start;
+	uint32 elapsed;
+	bool is_active;
+	bool is_running;
+};
+
+static const char* METRICS_PHASE_NAMES[METRICS_PHASES_COUNT] =
+{
+		"dns", "connect", "first_byte", "download", "parse", "query"
+};
+
+static struct metrics metrics;
+static struct metrics_timer metrics_timers[METRICS_PHASES_COUNT];
+
+static void metrics_record(struct metrics_phase* phase, uint32 duration)
+{
+	if (phase->count == 0)
+	{
+		phase->min = duration;
+		phase->max = duration;
+		phase->avg = duration;
+	}
+	else
+	{
+		phase->min = duration < phase->min ? duration : phase->min;
+		phase->max = duration > phase->max ? duration : phase->max;
+		phase->avg += ((sint32)duration - (sint32)phase->avg) / (1 << METRICS_EWMA_SHIFT);
+	}
+	phase->last = duration;
+	++phase->count;
+}
+
+void metrics_begin(uint8 phase)
+{
+	struct metrics_timer* timer = &metrics_timers[phase];
+	timer->start = system_get_time();
+	timer->elapsed = 0;
+	timer->is_active = true;
+	timer->is_running = true;
+	if (phase == METRICS_PHASE_QUERY)
+	{
+		metrics.query_min_free_heap = 0;
+		metrics.query_bytes_received = 0;
+		metrics_heap();
+	}
+}
+
+void metrics_pause(uint8 phase)
+{
+	struct metrics_timer* timer = &metrics_timers[phase];
+	if (timer->is_running)
+	{
+		timer->elapsed += system_get_time() - timer->start;
+		timer->is_running = false;
+	}
+}
+
+// Resumes paused phase (phase which is not active yet is begun)
+void metrics_resume(uint8 phase)
+{
+	struct metrics_timer* timer = &metrics_timers[phase];
+	if (!timer->is_active)
+	{
+		metrics_begin(phase);
+	}
+	else if (!timer->is_running)
+	{
+		timer->start = system_get_time();
+		timer->is_running = true;
+	}
+}
+
+void metrics_end(uint8 phase)
+{
+	struct metrics_timer* timer = &metrics_timers[phase];
+	if (timer->is_active)
+	{
+		metrics_pause(phase);
+		timer->is_active = false;
+		metrics_record(&metrics.phases[phase], timer->elapsed);
+	}
+}
+
+void metrics_fail(uint8 phase)
+{
+	struct metrics_timer* timer = &metrics_timers[phase];
+	if (timer->is_active)
+	{
+		timer->is_active = false;
+		timer->is_running = false;
+		++metrics.phases[phase].failures;
+	}
+}
+
+void metrics_heap(void)
+{
+	uint32 free_heap = system_get_free_heap_size();
+	if (metrics.query_min_free_heap == 0 || free_heap < metrics.query_min_free_heap)
+	{
+		metrics.query_min_free_heap = free_heap;
+	}
+	if (metrics.min_free_heap == 0 || free_heap < metrics.min_free_heap)
+	{
+		metrics.min_free_heap = free_heap;
+	}
+}
+
+void metrics_bytes(uint32 len)
+{
+	metrics.query_bytes_received += len;
+	metrics.bytes_received += len;
+}
+
+// Phases still in progress once query is finished have failed
+void metrics_finish_query(void)
+{
+	uint8 i;
+	for (i = 0; i < METRICS_PHASES_COUNT; ++i)
+	{
+		metrics_fail(i);
+	}
+}
+
+// Printed over UART only when building with UART_DEBUG_LOGS (the same as the rest of application logs)
+void metrics_print(void)
+{
+	uint8 i;
+	OS_UART_LOG("[INFO] Query metrics (us): phase count failures last min avg max\n");
+	for (i = 0; i < METRICS_PHASES_COUNT; ++i)
+	{
+		OS_UART_LOG("[INFO]   %s %d %d %d %d %d %d\n",
+				METRICS_PHASE_NAMES[i],
+				metrics.phases[i].count,
+				metrics.phases[i].failures,
+				metrics.phases[i].last,
+				metrics.phases[i].min,
+				metrics.phases[i].avg,
+				metrics.phases[i].max);
+	}
+	OS_UART_LOG("[INFO]   free heap min: %d (query: %d), bytes received: %d (query: %d)\n",
+			metrics.min_free_heap,
+			metrics.query_min_free_heap,
+			metrics.bytes_received,
+			metrics.query_bytes_received);
+}
+
+const struct metrics* metrics_get(void)
+{
+	return &metrics;
+}
+
+#endif
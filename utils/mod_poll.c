@@ -0,0 +1,154 @@
+#include "mod_poll.h"
+
+#include <osapi.h>
+
+// Adaptive polling: next query time is derived from smoothed rate of route time change
+// (stable traffic - longer interval, volatile traffic - shorter one), limited by time-of-day
+// windows and paced so that daily request budget is not exceeded. Time arguments: 'now' -
+// monotonic uptime in seconds, 'timestamp' - local wall clock time (0 while it is unknown,
+// day boundaries are taken from uptime until wall clock becomes known for the first time).
+
+static const struct poll_config* poll_config = NULL;
+static struct poll_stats poll_stats;
+static uint32 poll_last_result_time = 0;
+static bool poll_has_result = false;
+
+static uint32 poll_day(uint32 now, uint32 timestamp)
+{
+	return (timestamp ? timestamp : now) / POLL_SECONDS_PER_DAY;
+}
+
+static uint32 poll_second_of_day(uint32 now, uint32 timestamp)
+{
+	return (timestamp ? timestamp : now) % POLL_SECONDS_PER_DAY;
+}
+
+static void poll_update_day(uint32 now, uint32 timestamp)
+{
+	if (!timestamp && poll_stats.is_wall_day)
+	{
+		// wall clock day (e.g. restored after reset) is kept until clock is known again
+		return;
+	}
+	uint32 day = poll_day(now, timestamp);
+	if (timestamp && !poll_stats.is_wall_day)
+	{
+		// switching from uptime days - requests counted so far belong to the current day
+		poll_stats.is_wall_day = true;
+		poll_stats.day = day;
+		return;
+	}
+	if (day != poll_stats.day)
+	{
+		poll_stats.day = day;
+		poll_stats.requests_today = 0;
+	}
+}
+
+static const struct poll_window* poll_find_window(uint32 second_of_day)
+{
+	uint16 minute = second_of_day / 60;
+	uint8 i;
+	for (i = 0; i < poll_config->windows_count; ++i)
+	{
+		const struct poll_window* window = &poll_config->windows[i];
+		bool is_inside = (window->start_minute <= window->end_minute) ?
+				(minute >= window->start_minute && minute < window->end_minute) :
+				(minute >= window->start_minute || minute < window->end_minute);
+		if (is_inside)
+		{
+			return window;
+		}
+	}
+	return NULL;
+}
+
+void poll_init(const struct poll_config* config)
+{
+	poll_config = config;
+	os_bzero(&poll_stats, sizeof(struct poll_stats));
+	poll_last_result_time = 0;
+	poll_has_result = false;
+}
+
+// Counts submitted query against daily budget ('requests' - billed requests it takes)
+void poll_on_request(uint32 now, uint32 timestamp, uint16 requests)
+{
+	poll_update_day(now, timestamp);
+	poll_stats.requests_today += requests;
+}
+
+// Records completed update: 'change' - largest absolute route time change (seconds) since previous update
+void poll_on_result(uint32 now, uint32 change)
+{
+	if (poll_has_result && now > poll_last_result_time)
+	{
+		uint32 rate = (change * POLL_SECONDS_PER_HOUR) / (now - poll_last_result_time);
+		sint32 delta = (sint32)rate - (sint32)poll_stats.volatility;
+		poll_stats.volatility += delta / (1 << POLL_EWMA_SHIFT);
+	}
+	poll_last_result_time = now;
+	poll_has_result = true;
+}
+
+// Seconds until next update ('requests_per_update' - number of billed requests one update takes)
+uint32 poll_next_interval(uint32 now, uint32 timestamp, uint16 requests_per_update)
+{
+	uint32 min_interval = poll_config->min_interval;
+	uint32 max_interval = poll_config->max_interval;
+	uint32 second_of_day = poll_second_of_day(now, timestamp);
+	if (timestamp)
+	{
+		const struct poll_window* window = poll_find_window(second_of_day);
+		if (window)
+		{
+			min_interval = window->min_interval;
+			max_interval = window->max_interval;
+		}
+	}
+
+	// interval within which route time is expected to change by target value
+	uint32 interval = max_interval;
+	if (poll_stats.volatility > 0)
+	{
+		interval = (poll_config->target_change * POLL_SECONDS_PER_HOUR) / poll_stats.volatility;
+	}
+	if (interval < min_interval)
+	{
+		interval = min_interval;
+	}
+	if (interval > max_interval)
+	{
+		interval = max_interval;
+	}
+
+	// remaining budget is spread over the rest of the day (budget takes priority over interval limits)
+	poll_update_day(now, timestamp);
+	uint32 seconds_left = POLL_SECONDS_PER_DAY - second_of_day;
+	uint32 updates_left = 0;
+	if (poll_stats.requests_today < poll_config->daily_budget && requests_per_update > 0)
+	{
+		updates_left = (poll_config->daily_budget - poll_stats.requests_today) / requests_per_update;
+	}
+	if (updates_left == 0)
+	{
+		interval = seconds_left;
+	}
+	else if (interval < seconds_left / (updates_left * POLL_BUDGET_BURST))
+	{
+		interval = seconds_left / (updates_left * POLL_BUDGET_BURST);
+	}
+	poll_stats.last_interval = interval;
+	return interval;
+}
+
+const struct poll_stats* poll_get_stats(void)
+{
+	return &poll_stats;
+}
+
+// Restores statistics kept across reset (volatility, daily request count)
+void poll_restore(const struct poll_stats* stats)
+{
+	poll_stats = *stats;
+}
@@ -0,0 +1,41 @@
+#include "mod_routes.h"
+
+#include <osapi.h>
+
+// Copies flash-resident request URL into RAM buffer. Flash is mapped for 32-bit aligned
+// access only, so URL is read word by word (string itself is stored 4-byte aligned).
+// Non-empty 'api_key' replaces built-in key value (URL ends with key parameter)
+bool routes_load_url(const struct route_query* query, const char* api_key, char* output, size_t output_size)
+{
+	if (query->url_len >= output_size)
+	{
+		return false;
+	}
+	const uint32* source = (const uint32*)query->url;
+	uint16 i;
+	for (i = 0; i < query->url_len; i += 4)
+	{
+		uint32 word = source[i / 4];
+		uint8 j;
+		for (j = 0; j < 4 && i + j < query->url_len; ++j)
+		{
+			output[i + j] = (char)(word >> (j * 8));
+		}
+	}
+	output[query->url_len] = '\0';
+	if (api_key && api_key[0])
+	{
+		char* key = (char*)os_strstr(output, ROUTES_KEY_PARAM);
+		if (!key)
+		{
+			return false;
+		}
+		key += os_strlen(ROUTES_KEY_PARAM);
+		if (key - output + os_strlen(api_key) >= output_size)
+		{
+			return false;
+		}
+		os_strcpy(key, api_key);
+	}
+	return true;
+}
@@ -0,0 +1,66 @@
+#include "mod_rtcmem.h"
+
+#include <osapi.h>
+#include <user_interface.h>
+
+// Slot layout: magic (slot-specific), data size, checksum of data, data. Record is accepted only
+// if all of them match, so slots left from power-up garbage or other firmware layout are rejected.
+// RTC memory is accessed by 4-byte blocks only, records are staged in aligned buffer
+
+struct rtcmem_slot
+{
+	uint16 magic;
+	uint16 size;
+	uint32 checksum;
+	uint32 data[RTCMEM_SLOT_DATA_SIZE / sizeof(uint32)];
+};
+
+// FNV-1a hash (record size is mixed in as well)
+static uint32 rtcmem_checksum(const uint8* data, uint16 size)
+{
+	uint32 hash = 2166136261u ^ size;
+	uint16 i;
+	for (i = 0; i < size; ++i)
+	{
+		hash = (hash ^ data[i]) * 16777619u;
+	}
+	return hash;
+}
+
+static uint8 rtcmem_slot_block(uint8 slot)
+{
+	return RTCMEM_USER_BLOCK + slot * (RTCMEM_SLOT_SIZE / sizeof(uint32));
+}
+
+// Reads record of exactly 'size' bytes, returns false if slot holds no valid record of that size
+bool rtcmem_read(uint8 slot, void* data, uint16 size)
+{
+	struct rtcmem_slot buffer;
+	if (slot >= RTCMEM_SLOTS_COUNT || size > RTCMEM_SLOT_DATA_SIZE ||
+			!system_rtc_mem_read(rtcmem_slot_block(slot), &buffer, RTCMEM_SLOT_HEADER_SIZE + ((size + 3) & ~3)))
+	{
+		return false;
+	}
+	if (buffer.magic != (RTCMEM_MAGIC ^ slot) || buffer.size != size ||
+			buffer.checksum != rtcmem_checksum((const uint8*)buffer.data, size))
+	{
+		return false;
+	}
+	os_memcpy(data, buffer.data, size);
+	return true;
+}
+
+bool rtcmem_write(uint8 slot, const void* data, uint16 size)
+{
+	struct rtcmem_slot buffer;
+	if (slot >= RTCMEM_SLOTS_COUNT || size > RTCMEM_SLOT_DATA_SIZE)
+	{
+		return false;
+	}
+	os_bzero(&buffer, sizeof(struct rtcmem_slot));
+	os_memcpy(buffer.data, data, size);
+	buffer.magic = RTCMEM_MAGIC ^ slot;
+	buffer.size = size;
+	buffer.checksum = rtcmem_checksum((const uint8*)buffer.data, size);
+	return system_rtc_mem_write(rtcmem_slot_block(slot), &buffer, RTCMEM_SLOT_HEADER_SIZE + ((size + 3) & ~3));
+}
@@ -0,0 +1,154 @@
+#include "mod_sched.h"
+
+#include <osapi.h>
+#include <user_interface.h>
+
+// Deadline scheduler: tasks are registered once and armed with a deadline (one-shot)
+// or a period. Single SDK timer is armed (non-repeating) to the earliest deadline,
+// so CPU is woken up only when some task is actually due.
+
+static struct sched_task sched_tasks[SCHED_MAX_TASKS];
+static uint8 sched_tasks_count = 0;
+static struct sched_stats sched_stats;
+static os_timer_t sched_timer;
+static bool is_dispatching = false;
+// monotonic clock tracking (system time wraps around every ~71 minutes)
+static uint32 sched_last_system_time = 0;
+static uint64 sched_uptime_us = 0;
+
+uint64 sched_now_ms(void)
+{
+	uint32 now = system_get_time();
+	sched_uptime_us += (uint32)(now - sched_last_system_time);
+	sched_last_system_time = now;
+	return sched_uptime_us / 1000;
+}
+
+static bool sched_is_valid(sint8 task_id)
+{
+	return task_id >= 0 && task_id < sched_tasks_count;
+}
+
+// Arms timer to the earliest pending deadline
+static void sched_rearm(void)
+{
+	uint64 now = sched_now_ms();
+	uint64 delay = SCHED_MAX_SLEEP_MS;
+	uint8 i;
+	for (i = 0; i < sched_tasks_count; ++i)
+	{
+		if (sched_tasks[i].is_pending)
+		{
+			uint64 task_delay = sched_tasks[i].deadline > now ? sched_tasks[i].deadline - now : 0;
+			delay = task_delay < delay ? task_delay : delay;
+		}
+	}
+	os_timer_disarm(&sched_timer);
+	// zero delay is not allowed for SDK timers - due tasks are dispatched with the next 1 ms
+	os_timer_arm(&sched_timer, delay > 0 ? (uint32)delay : 1, 0);
+}
+
+static void sched_timer_handler(void* arg)
+{
+	++sched_stats.wakeups;
+	is_dispatching = true;
+	uint64 now = sched_now_ms();
+	uint8 i;
+	for (i = 0; i < sched_tasks_count; ++i)
+	{
+		struct sched_task* task = &sched_tasks[i];
+		if (!task->is_pending || task->deadline > now)
+		{
+			continue;
+		}
+		if (task->period)
+		{
+			// missed periods are skipped rather than executed back to back
+			task->deadline += task->period;
+			if (task->deadline <= now)
+			{
+				task->deadline = now + task->period;
+			}
+		}
+		else
+		{
+			task->is_pending = false;
+		}
+		++task->run_count;
+		++sched_stats.task_runs;
+		task->callback(task->arg);
+	}
+	is_dispatching = false;
+	sched_rearm();
+}
+
+void sched_init(void)
+{
+	os_bzero(sched_tasks, sizeof(sched_tasks));
+	os_bzero(&sched_stats, sizeof(struct sched_stats));
+	sched_tasks_count = 0;
+	sched_now_ms();
+	os_timer_disarm(&sched_timer);
+	os_timer_setfn(&sched_timer, (os_timer_func_t*)sched_timer_handler, NULL);
+}
+
+// Registers task: periodic tasks (period in ms) are started right away, one-shot tasks (period 0)
+// wait for sched_set_deadline. Returns task id or SCHED_INVALID_TASK if task table is full
+sint8 sched_add(const char* name, sched_task_callback callback, void* arg, uint32 period)
+{
+	if (sched_tasks_count >= SCHED_MAX_TASKS)
+	{
+		return SCHED_INVALID_TASK;
+	}
+	sint8 task_id = sched_tasks_count++;
+	struct sched_task* task = &sched_tasks[task_id];
+	task->name = name;
+	task->callback = callback;
+	task->arg = arg;
+	task->period = period;
+	task->run_count = 0;
+	task->is_pending = false;
+	if (period)
+	{
+		sched_set_deadline(task_id, period);
+	}
+	return task_id;
+}
+
+// (Re-)arms task to run after 'delay' ms (replaces its previous deadline)
+void sched_set_deadline(sint8 task_id, uint32 delay)
+{
+	if (!sched_is_valid(task_id))
+	{
+		return;
+	}
+	sched_tasks[task_id].deadline = sched_now_ms() + delay;
+	sched_tasks[task_id].is_pending = true;
+	if (!is_dispatching)
+	{
+		sched_rearm();
+	}
+}
+
+void sched_cancel(sint8 task_id)
+{
+	if (sched_is_valid(task_id))
+	{
+		sched_tasks[task_id].is_pending = false;
+	}
+}
+
+bool sched_is_pending(sint8 task_id)
+{
+	return sched_is_valid(task_id) && sched_tasks[task_id].is_pending;
+}
+
+const struct sched_task* sched_get_task(sint8 task_id)
+{
+	return sched_is_valid(task_id) ? &sched_tasks[task_id] : NULL;
+}
+
+const struct sched_stats* sched_get_stats(void)
+{
+	return &sched_stats;
+}
@@ -0,0 +1,206 @@
+#include "mod_station.h"
+#include "mod_rtcmem.h"
+#include "mod_sched.h"
+
+#include <osapi.h>
+#include <espconn.h>
+
+// Fast reconnect: BSSID, channel and DHCP lease of the last successful connection are kept in RTC memory.
+// Next connect goes straight to that access point on its channel with static IP configuration (no channel
+// scan and no DHCP exchange). If it does not get IP address within STATION_FAST_CONNECT_TIMEOUT or access
+// point refuses it, cached record is dropped and regular scan + DHCP connect is made instead. Record older than
+// STATION_CACHE_MAX_AGE (by RTC timer, which keeps counting across deep sleep) is not used, so the address
+// is never kept after router may have leased it to another host.
+
+struct station_cache
+{
+	uint8 bssid[6];
+	// 0 - no valid record
+	uint8 channel;
+	uint8 reserved;
+	uint32 ip;
+	uint32 netmask;
+	uint32 gw;
+	uint32 dns;
+	// RTC timer value and its calibrated period (us, Q12 fixed point) once lease was obtained
+	uint32 rtc_time;
+	uint32 rtc_period;
+};
+
+static struct station_config station_config;
+static struct station_cache station_cache;
+static struct station_stats station_stats;
+// access point station is associated with (taken from connected event)
+static uint8 connected_bssid[6];
+static uint8 connected_channel = 0;
+static bool is_fast_connecting = false;
+static bool is_connect_pending = false;
+static uint32 connect_start_time = 0;
+static sint8 fallback_task = SCHED_INVALID_TASK;
+
+static bool station_start_fast(void)
+{
+	struct station_config config = station_config;
+	struct ip_info info;
+	ip_addr_t dns;
+	config.bssid_set = 1;
+	os_memcpy(config.bssid, station_cache.bssid, sizeof(config.bssid));
+	info.ip.addr = station_cache.ip;
+	info.netmask.addr = station_cache.netmask;
+	info.gw.addr = station_cache.gw;
+	dns.addr = station_cache.dns;
+	wifi_station_dhcpc_stop();
+	// directed config is not written to flash (station config in flash is kept without BSSID)
+	if (!wifi_station_set_config_current(&config) || !wifi_set_ip_info(STATION_IF, &info))
+	{
+		return false;
+	}
+	espconn_dns_setserver(0, &dns);
+	wifi_set_channel(station_cache.channel);
+	is_fast_connecting = true;
+	sched_set_deadline(fallback_task, STATION_FAST_CONNECT_TIMEOUT);
+	return wifi_station_connect();
+}
+
+static bool station_start_scan(void)
+{
+	is_fast_connecting = false;
+	station_config.bssid_set = 0;
+	wifi_station_dhcpc_start();
+	wifi_station_set_config(&station_config);
+	return wifi_station_connect();
+}
+
+// Lease age in seconds (after external reset RTC timer restarts, age wraps around to a large value)
+static uint32 station_cache_age(void)
+{
+	uint32 ticks = system_get_rtc_time() - station_cache.rtc_time;
+	return (uint32)((((uint64)ticks * station_cache.rtc_period) >> 12) / 1000000);
+}
+
+static void station_drop_cache(void)
+{
+	os_bzero(&station_cache, sizeof(struct station_cache));
+	rtcmem_write(RTCMEM_SLOT_STATION, &station_cache, sizeof(struct station_cache));
+}
+
+// Directed connect has not got through - cached record is dropped and regular connect is made.
+// Once cached lease expires while station stays connected with it, DHCP client is started to renew it
+static void fallback_task_handler(void* arg)
+{
+	if (!is_fast_connecting)
+	{
+		return;
+	}
+	if (wifi_station_get_connect_status() == STATION_GOT_IP)
+	{
+		is_fast_connecting = false;
+		station_drop_cache();
+		wifi_station_dhcpc_start();
+		return;
+	}
+	++station_stats.fallbacks;
+	station_drop_cache();
+	wifi_station_disconnect();
+	station_start_scan();
+}
+
+// Stores access point and DHCP lease station has just got
+static void station_store_cache(void)
+{
+	struct ip_info info;
+	if (!connected_channel || !wifi_get_ip_info(STATION_IF, &info))
+	{
+		return;
+	}
+	os_memcpy(station_cache.bssid, connected_bssid, sizeof(station_cache.bssid));
+	station_cache.channel = connected_channel;
+	station_cache.ip = info.ip.addr;
+	station_cache.netmask = info.netmask.addr;
+	station_cache.gw = info.gw.addr;
+	station_cache.dns = espconn_dns_getserver(0).addr;
+	station_cache.rtc_time = system_get_rtc_time();
+	station_cache.rtc_period = system_rtc_clock_cali_proc();
+	rtcmem_write(RTCMEM_SLOT_STATION, &station_cache, sizeof(struct station_cache));
+}
+
+void station_init(void)
+{
+	os_bzero(&station_stats, sizeof(struct station_stats));
+	if (!rtcmem_read(RTCMEM_SLOT_STATION, &station_cache, sizeof(struct station_cache)))
+	{
+		os_bzero(&station_cache, sizeof(struct station_cache));
+	}
+	fallback_task = sched_add("station", fallback_task_handler, NULL, 0);
+}
+
+// Submits connect command: directed one with static IP if there is cached record, regular one otherwise
+bool station_connect(struct station_config* config)
+{
+	station_config = *config;
+	is_connect_pending = true;
+	connect_start_time = system_get_time();
+	if (station_cache.channel && (station_cache.rtc_period == 0 || station_cache_age() > STATION_CACHE_MAX_AGE))
+	{
+		// lease may have expired - regular connect with DHCP stores a fresh one
+		station_drop_cache();
+	}
+	if (station_cache.channel && station_start_fast())
+	{
+		return true;
+	}
+	return station_start_scan();
+}
+
+// Has to be called from WiFi event handler
+void station_on_event(const System_Event_t* event)
+{
+	switch (event->event)
+	{
+		case EVENT_STAMODE_CONNECTED:
+			os_memcpy(connected_bssid, event->event_info.connected.bssid, sizeof(connected_bssid));
+			connected_channel = event->event_info.connected.channel;
+			break;
+		case EVENT_STAMODE_DISCONNECTED:
+			connected_channel = 0;
+			if (is_fast_connecting && is_connect_pending)
+			{
+				// access point is gone or refuses association - no reason to wait for timeout
+				sched_set_deadline(fallback_task, 0);
+			}
+			break;
+		case EVENT_STAMODE_GOT_IP:
+			if (!is_connect_pending)
+			{
+				// lease renewed or SDK reconnected by DHCP on its own
+				if (!is_fast_connecting)
+				{
+					station_store_cache();
+				}
+				break;
+			}
+			is_connect_pending = false;
+			uint32 connect_time = (system_get_time() - connect_start_time) / 1000;
+			station_stats.is_last_connect_fast = is_fast_connecting;
+			if (is_fast_connecting)
+			{
+				++station_stats.fast_connects;
+				station_stats.last_fast_connect_time = connect_time;
+				// cached lease is renewed by DHCP once it expires
+				uint32 age = station_cache_age();
+				sched_set_deadline(fallback_task, age < STATION_CACHE_MAX_AGE ? (STATION_CACHE_MAX_AGE - age) * 1000 : 0);
+			}
+			else
+			{
+				++station_stats.scan_connects;
+				station_stats.last_scan_connect_time = connect_time;
+				station_store_cache();
+			}
+			break;
+	}
+}
+
+const struct station_stats* station_get_stats(void)
+{
+	return &station_stats;
+}
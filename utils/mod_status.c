@@ -0,0 +1,161 @@
+#include "mod_status.h"
+#include "mod_sched.h"
+
+#include <osapi.h>
+#include <espconn.h>
+
+// Status endpoint: single-client TCP server answering any request with JSON document rendered
+// by application into static buffer - serving status never allocates heap on its own and only
+// one response is in flight at a time
+
+#define STATUS_RESPONSE_HEADER \
+	"HTTP/1.1 200 OK\r\nContent-Type: application/json\r\nContent-Length: %d\r\nConnection: close\r\n\r\n"
+// Client connections waiting to be disconnected by close task (served one and rejected one),
+// connection which does not fit is dropped by idle timeout
+#define STATUS_CLOSE_SLOTS                      2
+
+static struct espconn status_espconn;
+static esp_tcp status_esp_tcp;
+static status_render_callback status_render = NULL;
+static struct status_server_stats status_stats;
+static char status_buffer[STATUS_BUFFER_SIZE];
+static bool is_response_pending = false;
+static struct espconn* status_close_queue[STATUS_CLOSE_SLOTS];
+static sint8 status_close_task = SCHED_INVALID_TASK;
+
+// Connection is disconnected from close task rather than from espconn callbacks
+static void status_close(struct espconn* pconn)
+{
+	uint8 i;
+	for (i = 0; i < STATUS_CLOSE_SLOTS; ++i)
+	{
+		if (status_close_queue[i] == pconn)
+		{
+			return;
+		}
+	}
+	for (i = 0; i < STATUS_CLOSE_SLOTS; ++i)
+	{
+		if (!status_close_queue[i])
+		{
+			status_close_queue[i] = pconn;
+			sched_set_deadline(status_close_task, 0);
+			return;
+		}
+	}
+}
+
+// Connection is gone (SDK releases it) - it must not be disconnected by close task anymore
+static void status_forget(struct espconn* pconn)
+{
+	uint8 i;
+	for (i = 0; i < STATUS_CLOSE_SLOTS; ++i)
+	{
+		if (status_close_queue[i] == pconn)
+		{
+			status_close_queue[i] = NULL;
+		}
+	}
+}
+
+static void status_close_task_handler(void* arg)
+{
+	uint8 i;
+	for (i = 0; i < STATUS_CLOSE_SLOTS; ++i)
+	{
+		struct espconn* pconn = status_close_queue[i];
+		if (pconn)
+		{
+			status_close_queue[i] = NULL;
+			espconn_disconnect(pconn);
+		}
+	}
+}
+
+static void status_on_sent_callback(void* arg)
+{
+	status_close((struct espconn*)arg);
+}
+
+static void status_on_disconnect_callback(void* arg)
+{
+	status_forget((struct espconn*)arg);
+	is_response_pending = false;
+}
+
+static void status_on_error_callback(void* arg, sint8 error)
+{
+	status_forget((struct espconn*)arg);
+	is_response_pending = false;
+}
+
+static void status_on_receive_callback(void* arg, char* data, unsigned short len)
+{
+	struct espconn* pconn = (struct espconn*)arg;
+	if (is_response_pending)
+	{
+		return;
+	}
+	char header[STATUS_HEADER_RESERVE];
+	char* body = status_buffer + STATUS_HEADER_RESERVE;
+	uint16 body_len = status_render(body, STATUS_BODY_SIZE);
+	uint16 header_len = os_sprintf(header, STATUS_RESPONSE_HEADER, body_len);
+	// header is placed right in front of body, so response is sent from buffer as a whole
+	char* response = body - header_len;
+	os_memcpy(response, header, header_len);
+	++status_stats.requests;
+	is_response_pending = true;
+	if (espconn_send(pconn, (uint8*)response, header_len + body_len) != ESPCONN_OK)
+	{
+		status_close(pconn);
+	}
+}
+
+static void status_on_connect_callback(void* arg)
+{
+	struct espconn* pconn = (struct espconn*)arg;
+	if (is_response_pending)
+	{
+		// previous response is still being sent
+		++status_stats.rejected;
+		status_close(pconn);
+		return;
+	}
+	espconn_regist_recvcb(pconn, status_on_receive_callback);
+	espconn_regist_sentcb(pconn, status_on_sent_callback);
+	espconn_regist_disconcb(pconn, status_on_disconnect_callback);
+	espconn_regist_reconcb(pconn, status_on_error_callback);
+}
+
+// Starts listening on 'port' (all interfaces)
+bool status_server_init(uint16 port, status_render_callback render)
+{
+	status_render = render;
+	os_bzero(&status_stats, sizeof(struct status_server_stats));
+	os_bzero(&status_espconn, sizeof(struct espconn));
+	os_bzero(&status_esp_tcp, sizeof(esp_tcp));
+	is_response_pending = false;
+	os_bzero(status_close_queue, sizeof(status_close_queue));
+	if (status_close_task == SCHED_INVALID_TASK)
+	{
+		status_close_task = sched_add("status_close", status_close_task_handler, NULL, 0);
+	}
+	status_espconn.type = ESPCONN_TCP;
+	status_espconn.state = ESPCONN_NONE;
+	status_espconn.proto.tcp = &status_esp_tcp;
+	status_esp_tcp.local_port = port;
+	espconn_regist_connectcb(&status_espconn, status_on_connect_callback);
+	if (espconn_accept(&status_espconn) != ESPCONN_OK)
+	{
+		return false;
+	}
+	// outbound query connection is never starved by status clients
+	espconn_tcp_set_max_con_allow(&status_espconn, 1);
+	espconn_regist_time(&status_espconn, STATUS_TIMEOUT, 0);
+	return true;
+}
+
+const struct status_server_stats* status_server_get_stats(void)
+{
+	return &status_stats;
+}
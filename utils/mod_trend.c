@@ -0,0 +1,81 @@
+#include "mod_trend.h"
+
+#include <osapi.h>
+
+// Trend estimation in integer math: each new sample gives slope over the whole ring span
+// (newest vs oldest kept sample), which is smoothed by EWMA. Prediction extrapolates the
+// latest sample by smoothed slope within limited horizon.
+
+static const struct trend_sample* trend_get_sample(const struct trend* trend, uint8 age)
+{
+	return &trend->samples[(trend->head + TREND_HISTORY_SIZE - 1 - age) % TREND_HISTORY_SIZE];
+}
+
+void trend_init(struct trend* trend)
+{
+	os_bzero(trend, sizeof(struct trend));
+}
+
+void trend_add(struct trend* trend, uint32 now, sint32 duration)
+{
+	// samples which are too old to describe current trend are dropped
+	while (trend->count > 0 && now - trend_get_sample(trend, trend->count - 1)->time > TREND_MAX_AGE)
+	{
+		--trend->count;
+	}
+	if (trend->count == 0)
+	{
+		trend->slope = 0;
+	}
+	trend->samples[trend->head].time = now;
+	trend->samples[trend->head].duration = duration;
+	trend->head = (trend->head + 1) % TREND_HISTORY_SIZE;
+	trend->count = trend->count < TREND_HISTORY_SIZE ? trend->count + 1 : TREND_HISTORY_SIZE;
+	if (trend->count < 2)
+	{
+		return;
+	}
+	const struct trend_sample* oldest = trend_get_sample(trend, trend->count - 1);
+	uint32 span = now - oldest->time;
+	if (span == 0)
+	{
+		return;
+	}
+	sint32 slope = (sint32)(((sint64)(duration - oldest->duration) * 3600) / (sint32)span);
+	if (trend->count == 2)
+	{
+		trend->slope = slope;
+	}
+	else
+	{
+		trend->slope += (slope - trend->slope) / (1 << TREND_EWMA_SHIFT);
+	}
+}
+
+// Predicted route time at 'now', returns false if there are no samples
+bool trend_predict(const struct trend* trend, uint32 now, sint32* output_duration)
+{
+	if (trend->count == 0)
+	{
+		return false;
+	}
+	const struct trend_sample* latest = trend_get_sample(trend, 0);
+	uint32 elapsed = now - latest->time;
+	elapsed = elapsed < TREND_MAX_HORIZON ? elapsed : TREND_MAX_HORIZON;
+	sint32 duration = latest->duration + (sint32)(((sint64)trend->slope * elapsed) / 3600);
+	*output_duration = duration > 0 ? duration : 1;
+	return true;
+}
+
+// Trend direction: rising / falling if route time is expected to change by at least 'min_change'
+// seconds within prediction horizon
+sint8 trend_direction(const struct trend* trend, sint32 min_change)
+{
+	sint32 change = (sint32)(((sint64)trend->slope * TREND_MAX_HORIZON) / 3600);
+	min_change = min_change > 0 ? min_change : 1;
+	if (trend->count < 2 || (change < min_change && change > -min_change))
+	{
+		return TREND_STABLE;
+	}
+	return change > 0 ? TREND_RISING : TREND_FALLING;
+}